@@ -0,0 +1,429 @@
+// end-to-end load test: a mock ircd on loopback floods headless clients
+// through the real connection, framing, parsing and queueing code while a
+// 60 Hz loop stands in for the ui thread.
+//
+//     load_bench [seconds] [lines/s] [channels] [users] [servers] [threads]
+//
+// lines/s of 0 sends as fast as the sockets take it. the ui loop first runs
+// a second against idle connections for a baseline frame time, then the
+// flood starts. like the app, the client only echoes each line to stdout
+// when built with IRCTF_TRACE, and such a run measures the echo too
+
+#include "connection_manager.hpp"
+#include "network.hpp"
+#include <algorithm>
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef IRCTF_TRACE
+#define TRACE_NOTE ", client echo on"
+#else
+#define TRACE_NOTE ""
+#endif
+
+namespace
+{
+    using asio::ip::tcp;
+    using clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        double seconds = 5;
+        double linesPerSecond = 200000;
+        int channels = 50;
+        int users = 2000;
+        int servers = 1;
+        size_t threads = 0;
+    };
+
+    std::atomic_bool flooding{false};
+    std::atomic<size_t> linesSent{0};
+    std::atomic<size_t> sendStalls{0};
+
+    // one client of the mock ircd. registers it, answers its JOINs and,
+    // once flooding is set, streams the traffic mix at the configured rate
+    class MockSession : public std::enable_shared_from_this<MockSession>
+    {
+        const Options& options;
+        tcp::socket socket;
+        asio::steady_timer ticker;
+        std::string input;
+        std::string pending;
+        std::string writing;
+        std::string nick = "*";
+        clock::time_point floodStart;
+        size_t sent = 0;
+        bool registered = false;
+
+    public:
+        MockSession(const Options& options, tcp::socket socket)
+            : options(options)
+            , socket(std::move(socket))
+            , ticker(this->socket.get_executor()) { }
+
+        void start()
+        {
+            read();
+            tick();
+        }
+
+    private:
+        void read()
+        {
+            asio::async_read_until(socket, asio::dynamic_buffer(input), '\n',
+                [self = shared_from_this()](const asio::error_code& error,
+                    size_t length)
+                {
+                    if (error)
+                    {
+                        self->ticker.cancel();
+                        return;
+                    }
+
+                    std::string line = self->input.substr(0, length);
+                    self->input.erase(0, length);
+                    self->command(line);
+                    self->read();
+                });
+        }
+
+        void command(std::string line)
+        {
+            while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+            {
+                line.pop_back();
+            }
+
+            if (line.starts_with("NICK "))
+            {
+                nick = line.substr(5);
+            }
+            else if (line.starts_with("USER ") && !registered)
+            {
+                registered = true;
+                pending += ":irc.mock 001 " + nick + " :Welcome to the mock\r\n";
+            }
+            else if (line.starts_with("JOIN "))
+            {
+                std::string channels = line.substr(5);
+                size_t begin = 0;
+
+                while (begin <= channels.size())
+                {
+                    size_t comma = std::min(channels.find(',', begin),
+                        channels.size());
+                    std::string channel = channels.substr(begin, comma - begin);
+                    pending += ":" + nick + "!~" + nick + "@localhost JOIN "
+                        + channel + "\r\n:irc.mock 366 " + nick + " " + channel
+                        + " :End of /NAMES list.\r\n";
+                    begin = comma + 1;
+                }
+            }
+
+            write();
+        }
+
+        void generate(size_t line)
+        {
+            std::string user = "user" + std::to_string(line * 7919
+                % options.users);
+            std::string channel = "#bench" + std::to_string(line
+                % options.channels);
+
+            switch (line % 20)
+            {
+            case 0:
+                pending += ":" + user + "!~" + user + "@host.example JOIN "
+                    + channel + "\r\n";
+                break;
+            case 1:
+                pending += ":" + user + "!~" + user + "@host.example PART "
+                    + channel + " :later\r\n";
+                break;
+            case 2:
+                pending += ":irc.mock 353 " + nick + " = " + channel + " :@op "
+                    + user + " alice bob carol dave eve mallory trent\r\n";
+                break;
+            case 3:
+                pending += ":irc.mock 366 " + nick + " " + channel
+                    + " :End of /NAMES list.\r\n";
+                break;
+            default:
+                pending += "@time=2024-01-01T00:00:00.000Z :" + user + "!~"
+                    + user + "@host.example PRIVMSG " + channel
+                    + " :load test line " + std::to_string(line)
+                    + " with enough text to look like chat\r\n";
+                break;
+            }
+        }
+
+        void tick()
+        {
+            ticker.expires_after(std::chrono::milliseconds(1));
+            ticker.async_wait([self = shared_from_this()](
+                const asio::error_code& error)
+            {
+                if (!error)
+                {
+                    self->flood();
+                    self->tick();
+                }
+            });
+        }
+
+        void flood()
+        {
+            if (!registered || !flooding)
+            {
+                return;
+            }
+
+            if (sent == 0 && floodStart == clock::time_point())
+            {
+                floodStart = clock::now();
+            }
+
+            size_t due = options.linesPerSecond > 0
+                ? static_cast<size_t>(options.linesPerSecond
+                    * std::chrono::duration<double>(clock::now() - floodStart)
+                    .count())
+                : sent + 4096;
+
+            // the client not reading fast enough shows up here, tcp having
+            // pushed back, rather than as an ever growing pending buffer
+            if (sent < due && pending.size() >= 1 << 20)
+            {
+                sendStalls.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            for (; sent < due && pending.size() < 1 << 20; ++sent)
+            {
+                generate(sent);
+            }
+
+            write();
+        }
+
+        void write()
+        {
+            if (!writing.empty() || pending.empty())
+            {
+                return;
+            }
+
+            size_t lines = std::count(pending.begin(), pending.end(), '\n');
+            writing.swap(pending);
+
+            asio::async_write(socket, asio::buffer(writing),
+                [self = shared_from_this(), lines](
+                    const asio::error_code& error, size_t)
+                {
+                    self->writing.clear();
+
+                    if (!error)
+                    {
+                        linesSent.fetch_add(lines, std::memory_order_relaxed);
+                        self->write();
+                    }
+                });
+        }
+    };
+
+    void accept(tcp::acceptor& acceptor, const Options& options)
+    {
+        acceptor.async_accept([&acceptor, &options](const asio::error_code&
+            error, tcp::socket socket)
+        {
+            if (!error)
+            {
+                std::make_shared<MockSession>(options, std::move(socket))
+                    ->start();
+                accept(acceptor, options);
+            }
+        });
+    }
+
+    // stand-in for visitResponse: the string copies and scrollback growth
+    // the ui does per line, without drawing
+    void consume(irc::response::responseVarient& response,
+        std::deque<std::string>& scrollback)
+    {
+        using namespace irc::response;
+
+        if (Privmsg* privmsg = std::get_if<Privmsg>(&response))
+        {
+            scrollback.push_back(std::string(privmsg->nick()) + ": "
+                + std::string(privmsg->message()));
+        }
+        else if (Join* join = std::get_if<Join>(&response))
+        {
+            scrollback.push_back(std::string(join->nick()) + " joined "
+                + std::string(join->channel()));
+        }
+        else if (Part* part = std::get_if<Part>(&response))
+        {
+            scrollback.push_back(std::string(part->nick()) + " left "
+                + std::string(part->channel()));
+        }
+        else if (Numeric* numeric = std::get_if<Numeric>(&response))
+        {
+            scrollback.emplace_back(numeric->parsed.raw());
+        }
+
+        if (scrollback.size() > 10000)
+        {
+            scrollback.pop_front();
+        }
+    }
+
+    struct FrameStats
+    {
+        std::vector<double> frames;
+        size_t lines = 0;
+
+        double percentile(double p)
+        {
+            if (frames.empty())
+            {
+                return 0;
+            }
+
+            std::sort(frames.begin(), frames.end());
+            return frames[std::min(frames.size() - 1,
+                static_cast<size_t>(p * frames.size()))];
+        }
+    };
+
+    // frames at 60 Hz for the given time; frame time is the fetch and
+    // consume work only, the sleep to the next frame is not counted
+    FrameStats runFrames(irc::ConnectionManager& connections,
+        std::chrono::duration<double> length)
+    {
+        using namespace std::chrono;
+
+        FrameStats stats;
+        std::vector<irc::ConnectionManager::Fetched> responses;
+        std::deque<std::string> scrollback;
+        clock::time_point end = clock::now()
+            + duration_cast<clock::duration>(length);
+        clock::time_point nextFrame = clock::now();
+
+        while (clock::now() < end)
+        {
+            clock::time_point start = clock::now();
+
+            responses.clear();
+            stats.lines += connections.fetch(responses);
+
+            for (auto& [server, response] : responses)
+            {
+                consume(response, scrollback);
+            }
+
+            stats.frames.push_back(duration<double, std::milli>(clock::now()
+                - start).count());
+
+            nextFrame += microseconds(16667);
+            std::this_thread::sleep_until(std::max(nextFrame, clock::now()));
+        }
+
+        return stats;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (argc > 1) options.seconds = std::max(0.1, std::atof(argv[1]));
+    if (argc > 2) options.linesPerSecond = std::max(0.0, std::atof(argv[2]));
+    if (argc > 3) options.channels = std::max(1, std::atoi(argv[3]));
+    if (argc > 4) options.users = std::max(1, std::atoi(argv[4]));
+    if (argc > 5) options.servers = std::max(1, std::atoi(argv[5]));
+    if (argc > 6) options.threads = std::max(0, std::atoi(argv[6]));
+
+    asio::io_context ircd;
+    tcp::acceptor acceptor(ircd, tcp::endpoint(asio::ip::make_address(
+        "127.0.0.1"), 0));
+    accept(acceptor, options);
+    std::thread ircdThread([&ircd] { ircd.run(); });
+    std::string port = std::to_string(acceptor.local_endpoint().port());
+
+    std::printf("mock ircd on 127.0.0.1:%s, %d server(s), %d channels, %d "
+        "users, %.0f lines/s per server%s%s\n", port.c_str(), options.servers,
+        options.channels, options.users, options.linesPerSecond,
+        options.linesPerSecond > 0 ? "" : " (unthrottled)", TRACE_NOTE);
+
+    {
+        irc::ConnectionManager connections(options.threads);
+
+        for (int i = 0; i < options.servers; ++i)
+        {
+            irc::Server& server = connections.add("127.0.0.1", port);
+            server.nick("silvermantis");
+            server.auth("silvermantis", "bench");
+
+            for (int channel = 0; channel < options.channels; ++channel)
+            {
+                server.join("#bench" + std::to_string(channel));
+            }
+
+            server.connect();
+        }
+
+        FrameStats idle = runFrames(connections,
+            std::chrono::seconds(1));
+
+        flooding = true;
+        clock::time_point floodStart = clock::now();
+        FrameStats loaded = runFrames(connections,
+            std::chrono::duration<double>(options.seconds));
+        double seconds = std::chrono::duration<double>(clock::now()
+            - floodStart).count();
+        flooding = false;
+
+        size_t maxDepth = 0;
+        size_t backlog = 0;
+
+        for (const std::unique_ptr<irc::Server>& server
+            : connections.getServers())
+        {
+            maxDepth = std::max(maxDepth, server->maxQueueDepth());
+            backlog += server->queueDepth();
+        }
+
+        std::printf("\nsent     %12.0f lines/s\n", linesSent.load() / seconds);
+        std::printf("consumed %12.0f lines/s\n", loaded.lines / seconds);
+        std::printf("max queue depth %zu, %zu left queued, %zu send stalls\n",
+            maxDepth, backlog, sendStalls.load());
+        std::printf("\nframe work (ms)     p50      p99      max\n");
+        std::printf("idle          %9.3f %8.3f %8.3f\n", idle.percentile(0.5),
+            idle.percentile(0.99), idle.percentile(1));
+        std::printf("loaded        %9.3f %8.3f %8.3f\n", loaded.percentile(0.5),
+            loaded.percentile(0.99), loaded.percentile(1));
+        std::printf("degradation   %+9.3f %+8.3f %+8.3f\n",
+            loaded.percentile(0.5) - idle.percentile(0.5),
+            loaded.percentile(0.99) - idle.percentile(0.99),
+            loaded.percentile(1) - idle.percentile(1));
+
+        for (const std::unique_ptr<irc::Server>& server
+            : connections.getServers())
+        {
+            server->quit();
+        }
+    }
+
+    ircd.stop();
+    ircdThread.join();
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+// memory per logged line of a channel's scrollback, before and after the
+// move to fixed size records over a text arena.
+//
+//     log_store_bench [lines] [users]
+//
+// "baseline" holds each item as the LogItem variant the display used to
+// keep, with its formatted time, nick and wrapped lines filled in as a
+// draw left them. "records" is the Scrollback with its line index, budget
+// unlimited so nothing spills; its nicks are atoms whose names the
+// network's table holds once, and are not counted here. heap bytes are counted by replacing the
+// global allocator; malloc's own per-allocation overhead is not included,
+// which flatters the baseline
+
+#include "line_index.hpp"
+#include "log_item.hpp"
+#include "scrollback.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace
+{
+    size_t liveBytes = 0;
+    size_t liveAllocations = 0;
+
+    // what every allocation is prefixed with, kept at max alignment
+    constexpr size_t header = alignof(std::max_align_t);
+}
+
+void* operator new(size_t size)
+{
+    char* block = static_cast<char*>(std::malloc(size + header));
+
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+
+    *reinterpret_cast<size_t*>(block) = size;
+    liveBytes += size;
+    ++liveAllocations;
+
+    return block + header;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (!pointer)
+    {
+        return;
+    }
+
+    char* block = static_cast<char*>(pointer) - header;
+    liveBytes -= *reinterpret_cast<size_t*>(block);
+    --liveAllocations;
+    std::free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+namespace
+{
+    namespace baseline
+    {
+        struct FormattedMessage
+        {
+            std::string timeLogged;
+            std::string nick;
+            std::vector<std::string> messageLines;
+        };
+
+        struct Message
+        {
+            std::time_t timeLogged;
+            std::string nick;
+            std::string rawMessage;
+            FormattedMessage formatted;
+        };
+
+        struct Join
+        {
+            std::string user;
+        };
+
+        struct Part
+        {
+            std::string user;
+            std::optional<std::string> message;
+        };
+
+        typedef std::variant<Message, Join, Part> LogItem;
+    }
+
+    // the load bench's traffic mix, one join and one part in twenty. users
+    // are atoms, as the network's table would hand out; the item views text
+    gui::log_item::LogItem generate(size_t line, int users, std::string& text)
+    {
+        irc::Atom user = line * 7919 % users;
+
+        switch (line % 20)
+        {
+        case 0:
+            return gui::log_item::Join{user};
+        case 1:
+            return gui::log_item::Part{user, line % 3 ? std::nullopt
+                : std::optional<std::string_view>("later")};
+        default:
+            text = "load test line " + std::to_string(line)
+                + " with enough text to look like chat";
+            return gui::log_item::Message{static_cast<std::time_t>(
+                1700000000 + line / 50), user, text};
+        }
+    }
+
+    // the nick the baseline copied into each item
+    std::string name(irc::Atom user)
+    {
+        return "user" + std::to_string(user);
+    }
+
+    struct Result
+    {
+        size_t bytes;
+        size_t allocations;
+        double seconds;
+    };
+
+    void report(const char* name, const Result& result, size_t lines)
+    {
+        std::printf("%-9s %8.1f B/line %6.2f allocs/line %10.0f lines/s "
+            "%8.1f MiB\n", name, double(result.bytes) / lines,
+            double(result.allocations) / lines, lines / result.seconds,
+            result.bytes / 1048576.0);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    using clock = std::chrono::steady_clock;
+
+    size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    int users = argc > 2 ? std::max(1, std::atoi(argv[2])) : 2000;
+
+    std::printf("%zu lines from %d users\n\n", lines, users);
+
+    {
+        size_t bytesBefore = liveBytes;
+        size_t allocationsBefore = liveAllocations;
+        clock::time_point start = clock::now();
+        std::vector<baseline::LogItem> messages;
+        std::string text;
+
+        for (size_t line = 0; line < lines; ++line)
+        {
+            gui::log_item::LogItem logItem = generate(line, users, text);
+
+            if (auto* message = std::get_if<gui::log_item::Message>(&logItem))
+            {
+                baseline::Message& logged = std::get<baseline::Message>(
+                    messages.emplace_back(baseline::Message{
+                        message->timeLogged, name(message->nick),
+                        std::string(message->rawMessage), {}}));
+                logged.formatted.timeLogged = "[12:34:56]";
+                logged.formatted.nick = '<' + logged.nick + '>';
+                logged.formatted.messageLines.push_back(logged.rawMessage);
+            }
+            else if (auto* join = std::get_if<gui::log_item::Join>(&logItem))
+            {
+                messages.emplace_back(baseline::Join{name(join->user)});
+            }
+            else
+            {
+                gui::log_item::Part& part = std::get<gui::log_item::Part>(
+                    logItem);
+                messages.emplace_back(baseline::Part{name(part.user),
+                    part.message ? std::optional<std::string>(*part.message)
+                        : std::nullopt});
+            }
+        }
+
+        report("baseline", Result{liveBytes - bytesBefore,
+            liveAllocations - allocationsBefore,
+            std::chrono::duration<double>(clock::now() - start).count()},
+            lines);
+    }
+
+    {
+        size_t bytesBefore = liveBytes;
+        size_t allocationsBefore = liveAllocations;
+        clock::time_point start = clock::now();
+        gui::Scrollback messages(SIZE_MAX);
+        gui::LineIndex lineIndex;
+        std::string text;
+
+        for (size_t line = 0; line < lines; ++line)
+        {
+            messages.push(generate(line, users, text));
+            lineIndex.push(1);
+        }
+
+        report("records", Result{liveBytes - bytesBefore,
+            liveAllocations - allocationsBefore,
+            std::chrono::duration<double>(clock::now() - start).count()},
+            lines);
+        std::printf("          of which %.1f B/line is the line index\n",
+            (lineIndex.size() * (sizeof(uint32_t) + sizeof(uint64_t)))
+                / double(lines));
+    }
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+// lines/sec of the ingest path (framing + tokenising) over a traffic corpus.
+//
+//     scan_bench [corpus] [repeat]
+//
+// the corpus is raw server-to-client bytes, e.g. a capture of a bouncer
+// replay; without one a synthetic mix of PRIVMSG, JOIN/PART, NAMES and PING
+// traffic is generated. "baseline" reproduces the substr-based framer and
+// word splitter this replaced
+
+#include "line_framer.hpp"
+#include "message.hpp"
+#include "scan.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::string synthesize(size_t lines)
+    {
+        std::string corpus;
+        std::string names;
+
+        for (int i = 0; i < 60; ++i)
+        {
+            names += (i % 7 ? "user" : "@op") + std::to_string(i) + ' ';
+        }
+
+        for (size_t i = 0; i < lines; ++i)
+        {
+            std::string nick = "nick" + std::to_string(i % 997);
+            std::string channel = "#channel" + std::to_string(i % 31);
+
+            switch (i % 20)
+            {
+            case 0:
+                corpus += ":" + nick + "!~" + nick + "@host.example JOIN "
+                    + channel + "\r\n";
+                break;
+            case 1:
+                corpus += ":" + nick + "!~" + nick + "@host.example PART "
+                    + channel + " :gone\r\n";
+                break;
+            case 2:
+            case 3:
+                corpus += ":irc.example 353 me = " + channel + " :" + names
+                    + "\r\n";
+                break;
+            case 4:
+                corpus += "PING :irc.example\r\n";
+                break;
+            default:
+                corpus += "@time=2024-01-01T00:00:00.000Z :" + nick + "!~"
+                    + nick + "@host.example PRIVMSG " + channel
+                    + " :this is message number " + std::to_string(i)
+                    + " with a little more text to look like chat\r\n";
+                break;
+            }
+        }
+
+        return corpus;
+    }
+
+    size_t baseline(const std::string& corpus, size_t readSize)
+    {
+        std::string overflow;
+        size_t lines = 0;
+
+        for (size_t pos = 0; pos < corpus.size(); pos += readSize)
+        {
+            std::string bufStr = corpus.substr(pos, readSize);
+
+            if (bufStr.back() != '\n')
+            {
+                overflow += bufStr;
+                continue;
+            }
+
+            bufStr = overflow + bufStr;
+            overflow.clear();
+
+            size_t lineEnd;
+            while ((lineEnd = bufStr.find("\r\n")) != std::string::npos)
+            {
+                std::string raw = bufStr.substr(0, lineEnd);
+                std::vector<std::string> words;
+                size_t wordEnd;
+
+                while ((wordEnd = raw.find(' ')) != std::string::npos)
+                {
+                    words.push_back(raw.substr(0, wordEnd));
+                    raw = raw.substr(++wordEnd);
+                }
+
+                if (!raw.empty())
+                {
+                    words.push_back(raw);
+                }
+
+                lines += !words.empty();
+                bufStr = bufStr.substr(lineEnd + 2);
+            }
+        }
+
+        return lines;
+    }
+
+    size_t framed(const std::string& corpus, size_t readSize)
+    {
+        irc::LineFramer framer;
+        size_t lines = 0;
+
+        for (size_t pos = 0; pos < corpus.size(); pos += readSize)
+        {
+            size_t length = std::min(readSize, corpus.size() - pos);
+            std::span<char> space = framer.prepare(length);
+            std::memcpy(space.data(), corpus.data() + pos, length);
+            framer.commit(length);
+
+            while (std::optional<std::string_view> line = framer.next())
+            {
+                irc::Message message(*line);
+                lines += !message.command().empty();
+            }
+        }
+
+        return lines;
+    }
+
+    template<typename F>
+    void report(const char* name, size_t bytes, int repeat, F&& run)
+    {
+        using clock = std::chrono::steady_clock;
+
+        size_t lines = 0;
+        auto start = clock::now();
+
+        for (int i = 0; i < repeat; ++i)
+        {
+            lines += run();
+        }
+
+        double seconds = std::chrono::duration<double>(clock::now() - start)
+            .count();
+
+        std::printf("%-24s %12.0f lines/s %9.1f MB/s\n", name, lines / seconds,
+            bytes * repeat / seconds / 1e6);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string corpus;
+
+    if (argc > 1)
+    {
+        std::ifstream file(argv[1], std::ios::binary);
+
+        if (!file)
+        {
+            std::fprintf(stderr, "cannot open %s\n", argv[1]);
+            return 1;
+        }
+
+        corpus.assign(std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>());
+    }
+    else
+    {
+        corpus = synthesize(200000);
+    }
+
+    int repeat = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+    std::printf("corpus: %zu bytes, %zu lines, detected %s\n\n", corpus.size(),
+        static_cast<size_t>(std::count(corpus.begin(), corpus.end(), '\n')),
+        irc::scan::levelName(irc::scan::detected()));
+
+    report("baseline (512B reads)", corpus.size(), repeat, [&]
+        { return baseline(corpus, 512); });
+
+    for (irc::scan::Level level : { irc::scan::Level::SCALAR,
+        irc::scan::Level::SSE2, irc::scan::Level::AVX2 })
+    {
+        if (level > irc::scan::detected())
+        {
+            continue;
+        }
+
+        irc::scan::setLevel(level);
+        std::string name = std::string("framer+parse ")
+            + irc::scan::levelName(level);
+
+        report(name.c_str(), corpus.size(), repeat, [&]
+            { return framed(corpus, 4096); });
+
+        std::vector<uint32_t> positions;
+        positions.reserve(corpus.size() / 8);
+        name = std::string("scan '\\n' ") + irc::scan::levelName(level);
+
+        report(name.c_str(), corpus.size(), repeat, [&]
+        {
+            positions.clear();
+            irc::scan::findAll(corpus.data(), corpus.size(), '\n', positions);
+            return positions.size();
+        });
+    }
+
+    return 0;
+}
@@ -15,6 +15,13 @@
 
 using namespace gui;
 
+// past this many separate areas one covering the window is cheaper
+#define MAX_DAMAGE_RECTS 16
+// bytes of log items each display keeps in memory before spilling to disk
+#define SCROLLBACK_BUDGET (8 << 20)
+// pixels a channel display gives up to its member list
+#define MEMBER_LIST_WIDTH 150
+
 GuiError::GuiError(std::string message) : message(message) { }
 
 const char* GuiError::what() const noexcept
@@ -29,6 +36,23 @@ void gui::init()
         throw GuiError("failed to initialize SDL");
     }
 
+    wakeEventType = SDL_RegisterEvents(1);
+
+    if (!wakeEventType)
+    {
+        throw GuiError("failed to register events");
+    }
+}
+
+void gui::wake()
+{
+    SDL_Event event{};
+    event.type = wakeEventType;
+    SDL_PushEvent(&event);
+}
+
+static BLFontFace loadFontFace()
+{
     #ifdef _WIN32
     std::string fontPath = "C:\\Windows\\Fonts\\Arial.ttf";
     #else
@@ -48,14 +72,27 @@ void gui::init()
     FcPatternDestroy(fcMatch);
     #endif
 
-    BLResult fontLoadResult = gui::blFontFace.createFromFile(fontPath.c_str());
+    BLFontFace fontFace;
+    BLResult fontLoadResult = fontFace.createFromFile(fontPath.c_str());
 
     if (fontLoadResult != BL_SUCCESS)
     {
         throw GuiError("failed to load font");
     }
 
+    return fontFace;
+}
+
+std::future<BLFontFace> gui::findFont()
+{
+    return std::async(std::launch::async, loadFontFace);
+}
+
+void gui::installFont(BLFontFace fontFace)
+{
+    blFontFace = std::move(fontFace);
     blFont.createFromFace(blFontFace, 15.f);
+    fontReady = true;
 }
 
 void gui::terminate()
@@ -92,6 +129,7 @@ Window::Window(int width, int height, std::string title)
     blImage.createFromData(width, height, BL_FORMAT_PRGB32, pixels->data(),
         width * 4);
     blContext = BLContext(blImage);
+    invalidate();
 }
 
 Window::~Window()
@@ -101,19 +139,101 @@ Window::~Window()
     SDL_DestroyWindow(window);
 }
 
-void Window::clear()
+void Window::invalidate(double x, double y, double width, double height)
 {
-    blContext.begin(blImage);
-    blContext.clearAll();
-    SDL_SetRenderDrawColor(renderer, 0x0a, 0x0b, 0x18, 0xff);
-    SDL_RenderClear(renderer);
+    // out to whole pixels, plus one for antialiased edges and strokes
+    BLRectI rect;
+    rect.x = std::max(0, static_cast<int>(std::floor(x)) - 1);
+    rect.y = std::max(0, static_cast<int>(std::floor(y)) - 1);
+    rect.w = std::min(this->width, static_cast<int>(std::ceil(x + width)) + 1)
+        - rect.x;
+    rect.h = std::min(this->height, static_cast<int>(std::ceil(y + height))
+        + 1) - rect.y;
+
+    if (rect.w <= 0 || rect.h <= 0)
+    {
+        return;
+    }
+
+    // fold in every area it touches so no pixel is cleared and drawn twice
+    for (size_t i = 0; i < damage.size();)
+    {
+        const BLRectI& other = damage[i];
+
+        if (rect.x < other.x + other.w && other.x < rect.x + rect.w
+            && rect.y < other.y + other.h && other.y < rect.y + rect.h)
+        {
+            int x1 = std::max(rect.x + rect.w, other.x + other.w);
+            int y1 = std::max(rect.y + rect.h, other.y + other.h);
+            rect.x = std::min(rect.x, other.x);
+            rect.y = std::min(rect.y, other.y);
+            rect.w = x1 - rect.x;
+            rect.h = y1 - rect.y;
+            damage.erase(damage.begin() + i);
+
+            // grown, so it may now reach areas already passed
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    damage.push_back(rect);
+
+    if (damage.size() > MAX_DAMAGE_RECTS)
+    {
+        invalidate();
+    }
 }
 
-void Window::display()
+void Window::invalidate()
 {
+    damage.assign(1, BLRectI(0, 0, width, height));
+}
+
+bool Window::damaged() const
+{
+    return !damage.empty();
+}
+
+bool Window::redrawing(double x, double y, double width, double height) const
+{
+    return x - 1 < redrawn.x + redrawn.w && redrawn.x < x + width + 1
+        && y - 1 < redrawn.y + redrawn.h && redrawn.y < y + height + 1;
+}
+
+void Window::render(const std::function<void()>& draw)
+{
+    blContext.begin(blImage);
+
+    for (const BLRectI& rect : damage)
+    {
+        // widgets clip for themselves and restoreClipping() returns to the
+        // state saved here, so they stay inside the area
+        redrawn = rect;
+        blContext.clipToRect(rect);
+        blContext.save();
+        blContext.clearRect(rect);
+        draw();
+        blContext.restore();
+        blContext.restoreClipping();
+    }
+
     blContext.end();
-    SDL_UpdateTexture(texture, nullptr, pixels->data(),
-        width * sizeof(uint32_t));
+
+    for (const BLRectI& rect : damage)
+    {
+        SDL_Rect area{rect.x, rect.y, rect.w, rect.h};
+        SDL_UpdateTexture(texture, &area, pixels->data() + rect.y * width
+            + rect.x, width * sizeof(uint32_t));
+    }
+
+    damage.clear();
+    redrawn = BLRectI(0, 0, 0, 0);
+
+    SDL_SetRenderDrawColor(renderer, 0x0a, 0x0b, 0x18, 0xff);
     SDL_RenderClear(renderer);
     SDL_RenderTexture(renderer, texture, nullptr, nullptr);
     SDL_RenderPresent(renderer);
@@ -124,6 +244,17 @@ bool Window::pollEvents(SDL_Event& event)
     return SDL_PollEvent(&event);
 }
 
+bool Window::waitEvent(SDL_Event& event, int timeoutMs)
+{
+    return SDL_WaitEventTimeout(&event, timeoutMs);
+}
+
+bool Window::visible() const
+{
+    return !(SDL_GetWindowFlags(window) & (SDL_WINDOW_HIDDEN
+        | SDL_WINDOW_MINIMIZED | SDL_WINDOW_OCCLUDED));
+}
+
 Widget::Widget(Window& window, double posX, double posY, double width,
     double height)
     : window{window}
@@ -132,6 +263,64 @@ Widget::Widget(Window& window, double posX, double posY, double width,
     , width{width}
     , height{height} { }
 
+void Widget::draw()
+{
+    if (!needsDraw())
+    {
+        return;
+    }
+
+    // whole pixels around the widget with one spare for antialiased edges
+    int x = static_cast<int>(std::floor(posX)) - 1;
+    int y = static_cast<int>(std::floor(posY)) - 1;
+    int layerWidth = static_cast<int>(std::ceil(posX + width)) + 1 - x;
+    int layerHeight = static_cast<int>(std::ceil(posY + height)) + 1 - y;
+
+    if (layer.width() != layerWidth || layer.height() != layerHeight)
+    {
+        layer.create(layerWidth, layerHeight, BL_FORMAT_PRGB32);
+        layerStale = true;
+    }
+
+    if (layerStale)
+    {
+        BLContext context(layer);
+        context.clearAll();
+        context.translate(-x, -y);
+
+        painter = &context;
+        render();
+        painter = nullptr;
+
+        context.end();
+        layerStale = false;
+    }
+
+    window.blContext.blitImage(BLPointI(x, y), layer);
+}
+
+BLContext& Widget::canvas()
+{
+    return *painter;
+}
+
+void Widget::invalidate()
+{
+    layerStale = true;
+    window.invalidate(posX, posY, width, height);
+}
+
+void Widget::releaseLayer()
+{
+    layer.reset();
+    layerStale = true;
+}
+
+bool Widget::needsDraw() const
+{
+    return window.redrawing(posX, posY, width, height);
+}
+
 std::vector<Selectable*> Selectable::existing;
 Selectable* Selectable::hovered = nullptr;
 Selectable* Selectable::selected = nullptr;
@@ -151,6 +340,8 @@ Selectable::~Selectable()
 
 void Selectable::findFocus(double mouseX, double mouseY)
 {
+    Selectable* found = nullptr;
+
     for (Selectable* hoverable : existing)
     {
         if (mouseX >= hoverable->posX
@@ -158,12 +349,46 @@ void Selectable::findFocus(double mouseX, double mouseY)
             && mouseY >= hoverable->posY
             && mouseY <= (hoverable->posY + hoverable->height))
         {
-            hovered = hoverable;
-            return;
+            found = hoverable;
+            break;
+        }
+    }
+
+    // hover highlights, so both ends of a change are redrawn
+    if (found != hovered)
+    {
+        if (hovered)
+        {
+            hovered->invalidate();
         }
+
+        if (found)
+        {
+            found->invalidate();
+        }
+
+        hovered = found;
+    }
+}
+
+void Selectable::setSelected(Selectable* selectable)
+{
+    if (selectable == selected)
+    {
+        return;
+    }
+
+    if (selected)
+    {
+        selected->invalidate();
     }
 
-    hovered = nullptr;
+    if (selectable)
+    {
+        selectable->invalidate();
+    }
+
+    selected = selectable;
 }
 
 Button::Button(Window& window, double posX, double posY, double width,
@@ -172,11 +397,6 @@ Button::Button(Window& window, double posX, double posY, double width,
     , label{label}
     , activate{activate} { }
 
-void Button::draw()
-{
-    draw(Selectable::hovered == this);
-}
-
 void Button::select()
 {
     if (activate)
@@ -184,46 +404,42 @@ void Button::select()
         activate();
     }
 
-    selected = nullptr;
+    setSelected(nullptr);
 }
 
-void Button::draw(bool highlight)
+void Button::render()
 {
+    bool highlight = Selectable::hovered == this;
+
     BLRoundRect roundRect(posX, posY, width, height, 2);
-    window.blContext.fillRoundRect(roundRect,
+    canvas().fillRoundRect(roundRect,
         highlight ? borderColor : bgColor);
-    window.blContext.setStrokeWidth(1.5);
-    window.blContext.strokeRoundRect(roundRect, borderColor);
+    canvas().setStrokeWidth(1.5);
+    canvas().strokeRoundRect(roundRect, borderColor);
 
-    BLGlyphBuffer glyphBuffer;
-    BLTextMetrics textMetrics;
-    glyphBuffer.setUtf8Text(label.c_str());
-    blFont.shape(glyphBuffer);
-    blFont.getTextMetrics(glyphBuffer, textMetrics);
+    const GlyphCache::ShapedText& text = glyphCache.get(blFont, label);
+    const BLTextMetrics& textMetrics = text.metrics;
 
     double textWidth = textMetrics.boundingBox.x1 - textMetrics.boundingBox.x0;
     double textHeight = blFont.metrics().ascent - blFont.metrics().descent;
 
-    window.blContext.setFillStyle(textColor);
-    window.blContext.fillUtf8Text(BLPoint(posX + width / 2.f - textWidth / 2.f,
-        posY + height - (height - textHeight) / 2.f), blFont, label.c_str());
+    canvas().setFillStyle(textColor);
+    canvas().fillGlyphRun(BLPoint(posX + width / 2.f - textWidth / 2.f,
+        posY + height - (height - textHeight) / 2.f), blFont, text.glyphRun());
 }
 
 TextBox::TextBox(Window& window, double posX, double posY, double width,
     double height)
     : Selectable(window, posX, posY, width, height, SelectType::TEXT_BOX) { }
 
-void TextBox::draw()
+void TextBox::render()
 {
-    draw(Selectable::hovered == this);
-}
+    bool highlight = Selectable::hovered == this;
 
-void TextBox::draw(bool highlight)
-{
     BLRect rect(posX, posY, width, height);
-    window.blContext.fillRect(rect, highlight ? highlightColor : bgColor);
-    window.blContext.setStrokeWidth(1.f);
-    window.blContext.strokeRect(rect, borderColor);
+    canvas().fillRect(rect, highlight ? highlightColor : bgColor);
+    canvas().setStrokeWidth(1.f);
+    canvas().strokeRect(rect, borderColor);
 
     int textStartX = posX + 3;
     int textEndX = textStartX;
@@ -231,11 +447,9 @@ void TextBox::draw(bool highlight)
     // draw text if any
     if (!textBuffer.empty())
     {
-        BLGlyphBuffer glyphBuffer;
-        glyphBuffer.setUtf8Text(textBuffer.c_str());
-        blFont.shape(glyphBuffer);
-        BLTextMetrics textMetrics;
-        blFont.getTextMetrics(glyphBuffer, textMetrics);
+        const GlyphCache::ShapedText& text = glyphCache.get(blFont,
+            textBuffer);
+        const BLTextMetrics& textMetrics = text.metrics;
 
         textEndX += textMetrics.advance.x;
 
@@ -249,254 +463,338 @@ void TextBox::draw(bool highlight)
         double textWidth = textMetrics.boundingBox.x1
             - textMetrics.boundingBox.x0;
         double textHeight = blFont.metrics().ascent - blFont.metrics().descent;
-        window.blContext.setFillStyle(textColor);
-        window.blContext.clipToRect(BLRect(posX, posY, width, height));
-        window.blContext.fillUtf8Text(BLPoint(textStartX, posY + height -
-            (height - textHeight) / 2.f), blFont, textBuffer.c_str());
-        window.blContext.restoreClipping();
+        canvas().setFillStyle(textColor);
+        canvas().clipToRect(BLRect(posX, posY, width, height));
+        canvas().fillGlyphRun(BLPoint(textStartX, posY + height -
+            (height - textHeight) / 2.f), blFont, text.glyphRun());
+        canvas().restoreClipping();
     }
     
     if (selected == this)
     {
         BLLine cursor = BLLine(textEndX + 3, posY + height - 3, textEndX + 13,
             posY + height - 3);
-        window.blContext.strokeLine(cursor, textColor);
+        canvas().strokeLine(cursor, textColor);
     }
 }
 
 void TextBox::select()
 {
-    selected = this;
+    setSelected(this);
 }
 
 void TextBox::writeChar(char input)
 {
     textBuffer += input;
+    completions.clear();
+    invalidate();
 }
 
 void TextBox::eraseChar()
 {
     textBuffer.pop_back();
+    completions.clear();
+    invalidate();
 }
 
-MessageDisplay::MessageDisplay(Window &window, double posX, double posY,
-    double width, double height) : Widget(window, posX, posY, width, height) { }
-
-void MessageDisplay::draw()
+void TextBox::complete(const std::function<std::vector<std::string>(
+    std::string_view word)>& candidates)
 {
-    BLRoundRect roundRect(posX, posY, width, height, 5);
-    window.blContext.fillRoundRect(roundRect, bgColor);
-    window.blContext.setStrokeWidth(1.f);
-    window.blContext.strokeRoundRect(roundRect, borderColor);
+    // anything since the last completion starts over on a new word
+    if (completions.empty() || textBuffer.size() != completedSize)
+    {
+        size_t space = textBuffer.rfind(' ');
+        completionStart = space == std::string::npos ? 0 : space + 1;
 
-    const double lineHeight = blFont.size() + 2;
+        if (completionStart == textBuffer.size())
+        {
+            return;
+        }
 
-    double offsetX = 10;
-    double offsetY = lineHeight;
-    const double maxMessagesVisible = (height - lineHeight) / lineHeight;
-    double messagesScrolled = (messages.size() - maxMessagesVisible) *
-        scrollPercent;
-    offsetY -= std::fmod(messagesScrolled, 1) * lineHeight;
+        completions = candidates(std::string_view(textBuffer)
+            .substr(completionStart));
+        completionIndex = 0;
 
-    if (messagesScrolled < 0)
+        if (completions.empty())
+        {
+            return;
+        }
+    }
+    else
     {
-        messagesScrolled = 0;
+        completionIndex = (completionIndex + 1) % completions.size();
     }
 
-    bool drawScrollbar = false;
-
-    window.blContext.setFillStyle(textColor);
-    window.blContext.clipToRect(BLRect(posX, posY, width, height));
+    const std::string& completion = completions[completionIndex];
 
-    BLGlyphBuffer glyphBuffer;
-    BLTextMetrics textMetrics;
-    blFont.shape(glyphBuffer);
-    glyphBuffer.setUtf8Text(" ");
-    blFont.getTextMetrics(glyphBuffer, textMetrics);
+    // a nick opening the line addresses its owner
+    textBuffer.resize(completionStart);
+    textBuffer += completion;
+    textBuffer += completionStart == 0 && completion.front() != '#' ? ": "
+        : " ";
+    completedSize = textBuffer.size();
+    invalidate();
+}
 
-    const double spaceWidth = textMetrics.advance.x;
+MessageDisplay::MessageDisplay(Window &window, double posX, double posY,
+    double width, double height, double membersWidth)
+    : Widget(window, posX, posY, width - membersWidth, height)
+    , messages(SCROLLBACK_BUDGET)
+    , memberList(window, posX + width - membersWidth + 5, posY,
+        std::max(membersWidth - 5, 0.0), height) { }
 
-    int offsetYTest = offsetY;
-    double offsetXText = offsetX;
+void MessageDisplay::draw()
+{
+    Widget::draw();
 
-    int nLines = 0;
-    int nNewlines = 0;
+    if (memberList.width > 0)
+    {
+        memberList.draw();
+    }
+}
 
-    // calculate range of log items to be printed
-    std::pair<
-        std::vector<log_item::LogItem>::iterator,
-        std::vector<log_item::LogItem>::iterator
-    > printRange;
+void MessageDisplay::render()
+{
+    BLRoundRect roundRect(posX, posY, width, height, 5);
+    canvas().fillRoundRect(roundRect, bgColor);
+    canvas().setStrokeWidth(1.f);
+    canvas().strokeRoundRect(roundRect, borderColor);
 
-    printRange.first = messages.begin() + std::floor(messagesScrolled);
-    printRange.second = messages.end();
+    const double lineHeight = blFont.size() + 2;
 
-    for (
-        auto logItem = printRange.first;
-        logItem != printRange.second;
-        logItem++
-    ) {
-        if (nLines - nNewlines > maxMessagesVisible)
+    // columns and wrapping follow the width and the font
+    if (width != layoutWidth || blFont.face().uniqueId() != layoutFace
+        || blFont.size() != layoutFontSize)
+    {
+        layoutWidth = width;
+        layoutFace = blFont.face().uniqueId();
+        layoutFontSize = blFont.size();
+        nickPosX = 0;
+        msgPosX = 0;
+
+        // spilled messages widen the columns as they are paged back in
+        for (size_t item = messages.residentBegin(); item < messages.size();
+            ++item)
         {
-            break;
-        }
+            Scrollback::Item entry = messages[item];
 
-        if (logItem->index() == log_item::LogItemType::MESSAGE)
-        {
-            formatMessage(
-                &std::get<log_item::Message>(*logItem),
-                &nLines,
-                &nNewlines,
-                &maxMessagesVisible,
-                &offsetXText,
-                &spaceWidth,
-                &offsetYTest,
-                &lineHeight
-            );
+            if (entry.record.kind == log_item::LogItemType::MESSAGE)
+            {
+                updateColumns(entry);
+            }
         }
-        else
+
+        relayout();
+    }
+
+    const double spaceWidth = glyphCache.get(blFont, " ").advance();
+
+    // following the log, the newest items are measured first so the view
+    // ends exactly on the last line
+    if (following)
+    {
+        double measured = 0;
+
+        for (size_t item = messages.size(); item > 0 && measured < height;)
         {
-            nLines++;
+            measured += measureItem(--item, &spaceWidth) * lineHeight;
         }
+
+        scrollTop = maxScroll();
+    }
+    else
+    {
+        scrollTop = std::min(scrollTop, maxScroll());
     }
 
-    double wrapOverflowShift {
-        offsetYTest > height
-            ? (offsetYTest - height) * scrollPercent
-            : 0
-    };
+    canvas().setFillStyle(textColor);
+    canvas().clipToRect(BLRect(posX, posY, width, height));
+
+    const double offsetX = textInset;
+
+    // find the first item in view, then measure and draw only the items
+    // down to the bottom edge
+    size_t item = lineIndex.itemAt(scrollTop / lineHeight);
+    double offsetY = (lineIndex.linesBefore(item) + 1) * lineHeight;
 
     for (
-        auto logItem = printRange.first;
-        logItem != printRange.second;
-        logItem++
+        ;
+        item < messages.size() && offsetY - scrollTop < height + lineHeight;
+        ++item
     ) {
-        switch (logItem->index())
+        measureItem(item, &spaceWidth);
+        Scrollback::Item entry = messages[item];
+
+        switch (entry.record.kind)
         {
         case log_item::LogItemType::MESSAGE:
-            drawItem(
-                &std::get<log_item::Message>(*logItem).formatted,
+            drawMessage(
+                entry,
                 &offsetY,
-                &wrapOverflowShift,
+                &scrollTop,
                 &offsetX,
                 &lineHeight
             );
             break;
         case log_item::LogItemType::JOIN:
-            drawItem(
-                &std::get<log_item::Join>(*logItem),
+            drawJoin(
+                entry,
                 &offsetX,
                 &offsetY,
-                &wrapOverflowShift,
+                &scrollTop,
                 &lineHeight
             );
             break;
         case log_item::LogItemType::PART:
-            drawItem(
-                &std::get<log_item::Part>(*logItem),
+            drawPart(
+                entry,
                 &offsetX,
                 &offsetY,
-                &wrapOverflowShift,
+                &scrollTop,
                 &lineHeight
             );
             break;
         }
     }
 
-    if (nLines > std::floor(maxMessagesVisible))
+    const double bottom = maxScroll();
+
+    if (bottom > 0)
     {
-        double scrollbarLen =
-            height
-            * maxMessagesVisible
-            / (double)messages.size();
-        double scrollPosY = posY + scrollPercent * (height - scrollbarLen);
+        double scrollbarLen = std::max(height * height / (height + bottom),
+            10.0);
+        double scrollPosY = posY + scrollTop / bottom * (height - scrollbarLen);
         BLLine scrollLine(posX + width - 7, scrollPosY, posX + width - 7,
             scrollPosY + scrollbarLen);
-        window.blContext.setStrokeWidth(5);
-        window.blContext.strokeLine(scrollLine, textColor);
+        canvas().setStrokeWidth(5);
+        canvas().strokeLine(scrollLine, textColor);
     }
 
-    window.blContext.restoreClipping();
+    canvas().restoreClipping();
 }
 
-void MessageDisplay::logMessage(log_item::LogItem&& logItem)
+uint32_t MessageDisplay::measureItem(size_t item, const double* spaceWidth)
 {
-    messages.emplace_back(logItem);
+    Scrollback::Item entry = messages[item];
+
+    if (entry.record.kind == log_item::LogItemType::MESSAGE)
+    {
+        // never laid out, paged back in from disk
+        if (!entry.layout.generation)
+        {
+            updateColumns(entry);
+        }
+
+        lineIndex.set(item, formatMessage(entry, spaceWidth));
+    }
+
+    return lineIndex.lines(item);
 }
 
-void MessageDisplay::scroll(double distance)
+double MessageDisplay::maxScroll() const
 {
     const double lineHeight = blFont.size() + 2;
-    const double maxMessagesVisible = (height - lineHeight) / lineHeight;
-    const double scrollableDistance = ((double)messages.size() -
-        maxMessagesVisible) * lineHeight;
 
-    if (scrollableDistance <= 0)
+    // the last line keeps clear of the bottom border
+    return std::max(lineIndex.total() * lineHeight + 5 - height, 0.0);
+}
+
+void MessageDisplay::logMessage(const log_item::LogItem& logItem)
+{
+    messages.push(logItem);
+
+    // before the first render there is no font to measure with
+    if (layoutFontSize != 0
+        && logItem.index() == log_item::LogItemType::MESSAGE)
     {
-        return;
+        updateColumns(messages[messages.size() - 1]);
     }
 
-    scrollPercent += distance / scrollableDistance;
+    // messages are counted as one line until they are first drawn
+    lineIndex.push(1);
 
-    if (scrollPercent < 0)
+    // tabs in the background are rendered when they are switched to
+    if (shown)
     {
-        scrollPercent = 0;
+        invalidate();
     }
-    else if (scrollPercent > 1)
+    else
     {
-        scrollPercent = 1;
+        layerStale = true;
     }
 }
 
+void MessageDisplay::trim()
+{
+    messages.trim();
+
+    if (!shown)
+    {
+        releaseLayer();
+    }
+}
+
+void MessageDisplay::scroll(double distance)
+{
+    const double bottom = maxScroll();
+
+    if (bottom <= 0)
+    {
+        return;
+    }
+
+    invalidate();
+    scrollTop = std::clamp((following ? bottom : scrollTop) + distance, 0.0,
+        bottom);
+    following = scrollTop >= bottom;
+}
+
 Tab::Tab(Window& window, double posX, double posY, double width, double height,
-    std::string name, TabBar& tabBar)
+    std::string name, ChannelKey key, TabBar& tabBar)
     : Selectable(window, posX, posY, width, height)
     , name{name}
+    , key{key}
     , tabBar{tabBar} { }
 
-void Tab::draw()
+void Tab::render()
 {
     BLRoundRect roundRect{posX, posY, width, height + 5, 10};
-    window.blContext.clipToRect(BLRect(posX, posY, width, height));
+    canvas().clipToRect(BLRect(posX, posY, width, height));
 
-    window.blContext.fillRoundRect(roundRect, tabBar.activeTab->first.get() ==
+    canvas().fillRoundRect(roundRect, tabBar.activeTab->first.get() ==
         this ? activeColor : bgColor);
-    window.blContext.setStrokeWidth(1);
-    window.blContext.strokeRoundRect(roundRect, borderColor);
+    canvas().setStrokeWidth(1);
+    canvas().strokeRoundRect(roundRect, borderColor);
 
-    BLGlyphBuffer glyphBuffer;
-    BLTextMetrics textMetrics;
-    blFont.shape(glyphBuffer);
-    glyphBuffer.setUtf8Text(name.c_str());
-    blFont.getTextMetrics(glyphBuffer, textMetrics);
+    const GlyphCache::ShapedText& text = glyphCache.get(blFont, name);
 
     BLPoint textPos {
-        (width - textMetrics.advance.x) / 2 + posX,
+        (width - text.advance()) / 2 + posX,
         posY + height - (height - blFont.size()) / 2 - 2
     };
 
-    window.blContext.fillUtf8Text(textPos, blFont, name.c_str());
+    canvas().fillGlyphRun(textPos, blFont, text.glyphRun());
 
-    window.blContext.restoreClipping();
+    canvas().restoreClipping();
 }
 
 void Tab::select()
 {
     try
     {
-        tabBar.activeTab = &tabBar.messageDisplays.at(name);
+        tabBar.setActiveTab(&tabBar.messageDisplays.at(key));
     }
     catch (std::exception& e)
     {
-        tabBar.activeTab = nullptr;
+        tabBar.setActiveTab(nullptr);
     }
 }
 
 TabBar::TabBar(Window& window, double posX, double posY, double width, double
     height) : Widget(window, posX, posY, width, height)
 {
-    addChannel("global");
-    activeTab = &messageDisplays.at("global");
+    addChannel(globalKey, "global");
+    setActiveTab(&messageDisplays.at(globalKey));
 }
 
 void TabBar::draw()
@@ -510,17 +808,79 @@ void TabBar::draw()
     }
 }
 
-void TabBar::addChannel(const std::string& name)
+void TabBar::setActiveTab(std::pair<std::unique_ptr<Tab>, MessageDisplay>* tab)
+{
+    // the highlight moves between tabs, and a hidden display gives up its
+    // layer rather than hold a window sized image per channel
+    if (activeTab)
+    {
+        activeTab->first->invalidate();
+        activeTab->second.shown = false;
+        activeTab->second.releaseLayer();
+        activeTab->second.memberList.shown = false;
+        activeTab->second.memberList.releaseLayer();
+    }
+
+    activeTab = tab;
+
+    if (activeTab)
+    {
+        activeTab->first->invalidate();
+        activeTab->second.shown = true;
+        activeTab->second.invalidate();
+        activeTab->second.memberList.shown = true;
+        activeTab->second.memberList.invalidate();
+    }
+
+    invalidate();
+}
+
+void TabBar::addChannel(ChannelKey key, const std::string& name)
 {
-    messageDisplays.emplace(name, std::make_pair(std::make_unique<Tab>(window,
-        tabX, posY, 100, height, name, *this), MessageDisplay(window, posX,
-        posY + height, width, 500)));
+    // rejoining after a reconnect keeps the existing tab and scrollback
+    if (messageDisplays.contains(key))
+    {
+        return;
+    }
+
+    // channels share the display's width with their member list
+    messageDisplays.emplace(key, std::make_pair(std::make_unique<Tab>(window,
+        tabX, posY, 100, height, name, key, *this), MessageDisplay(window, posX,
+        posY + height, width, 500, key == globalKey ? 0 : MEMBER_LIST_WIDTH)));
+    messageDisplays.at(key).first->invalidate();
     tabX += 100;
 }
 
-void TabBar::closeTab(const std::string& channel)
+std::vector<std::string> TabBar::completeChannel(std::string_view prefix,
+    uint32_t network, irc::CaseMapping caseMapping) const
+{
+    std::vector<std::string> found;
+
+    for (const auto& [key, tab] : messageDisplays)
+    {
+        const std::string& name = tab.first->getName;
+
+        if (key != globalKey && networkOf(key) == network
+            && name.size() >= prefix.size()
+            && std::equal(prefix.begin(), prefix.end(), name.begin(),
+                [&](char a, char b)
+                {
+                    return irc::foldCase(a, caseMapping)
+                        == irc::foldCase(b, caseMapping);
+                }))
+        {
+            found.push_back(name);
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+
+    return found;
+}
+
+void TabBar::closeTab(ChannelKey key)
 {
-    auto messageDisplay = messageDisplays.find(channel);
+    auto messageDisplay = messageDisplays.find(key);
 
     if (messageDisplay == messageDisplays.end())
     {
@@ -532,10 +892,11 @@ void TabBar::closeTab(const std::string& channel)
 
     if (&messageDisplay->second == activeTab)
     {
-        activeTab = &messageDisplays.at("global");
+        setActiveTab(&messageDisplays.at(globalKey));
     }
 
     messageDisplays.erase(messageDisplay);
+    invalidate();
 
     // shift proceeding tabs to fill empty space
     for (auto tab = messageDisplays.begin(); tab != messageDisplays.end();
@@ -7,9 +7,14 @@
 #include <SDL3/SDL.h>
 #include <vector>
 #include <functional>
+#include <future>
 #include <ctime>
 
+#include "gui/glyph_cache.hpp"
+#include "gui/line_index.hpp"
+#include "gui/scrollback.hpp"
 #include "gui/log_item.hpp"
+#include "../irc/atom_table.hpp"
 
 namespace gui
 {
@@ -19,10 +24,21 @@ namespace gui
     class Selectable;
     class Button;
     class TextBox;
+    class MemberList;
     class MessageDisplay;
     class Tab;
     class TabBar;
 
+    // identifies a channel's tab; the network's atom table id in the high
+    // half and the channel's atom in the low
+    typedef uint64_t ChannelKey;
+
+    // the atom table id of the network a tab belongs to, 0 for global
+    inline uint32_t networkOf(ChannelKey key)
+    {
+        return static_cast<uint32_t>(key >> 32);
+    }
+
     class GuiError : public std::exception
     {
         std::string message;
@@ -34,6 +50,15 @@ namespace gui
     void init();
     void terminate();
 
+    // pushes an event that ends Window::waitEvent, safe from any thread
+    void wake();
+    inline uint32_t wakeEventType = 0;
+
+    // locates and loads the ui font off the calling thread; hand the result
+    // to installFont() on the ui thread once it is ready
+    std::future<BLFontFace> findFont();
+    void installFont(BLFontFace fontFace);
+
     class Window
     {
         int width;
@@ -43,19 +68,42 @@ namespace gui
         SDL_Texture* texture;
         std::unique_ptr<std::vector<uint32_t>> pixels;
         BLImage blImage;
+        // areas to redraw and upload on the next render(), disjoint
+        std::vector<BLRectI> damage;
+        BLRectI redrawn{0, 0, 0, 0};
     public:
         Window(int width, int height, std::string title);
         ~Window();
         BLContext blContext;
-        void clear();
-        void display();
+
+        // marks an area, or the whole window, for the next render()
+        void invalidate(double x, double y, double width, double height);
+        void invalidate();
+        bool damaged() const;
+        // whether render() is redrawing any part of the area right now
+        bool redrawing(double x, double y, double width, double height) const;
+        // clears each damaged area and redraws it through draw, clipped to
+        // the area, then uploads only those pixels to the texture
+        void render(const std::function<void()>& draw);
+
         bool pollEvents(SDL_Event& event);
+        // blocks for up to timeoutMs, or until an event when -1
+        bool waitEvent(SDL_Event& event, int timeoutMs);
+        // false while hidden, minimized or fully covered
+        bool visible() const;
     };
 
     class Widget
     {
+        // the widget as last rendered, composited until invalidated
+        BLImage layer;
+        BLContext* painter = nullptr;
     protected:
         Window& window;
+        bool layerStale = true;
+        // rasterizes the widget in window coordinates onto canvas()
+        virtual void render() { }
+        BLContext& canvas();
     public:
         Widget(Window& window, double posX, double posY, double width,
             double height);
@@ -63,7 +111,14 @@ namespace gui
         double posY;
         double width;
         double height;
-        virtual void draw() = 0;
+        // composites the layer onto the window, rendering it first if stale
+        virtual void draw();
+        // queues the widget's area for redrawing and its layer for rendering
+        void invalidate();
+        // frees the layer until the widget is next drawn
+        void releaseLayer();
+        // false when render() is redrawing only areas away from the widget
+        bool needsDraw() const;
     };
 
     class Selectable : public Widget
@@ -77,6 +132,7 @@ namespace gui
         ~Selectable();
 
         static void findFocus(double mouseX, double mouseY);
+        static void setSelected(Selectable* selectable);
         static Selectable* hovered;
         static Selectable* selected;
         virtual void select() = 0;
@@ -91,10 +147,9 @@ namespace gui
         BLRgba32 borderColor = BLRgba32(0xff686881);
         BLRgba32 textColor = BLRgba32(0xffffffff);
 
-        void draw(bool highlight);
         Button(Window& window, double posX, double posY, double width,
             double height, std::string label, std::function<void()>&& activate);
-        void draw() override;
+        void render() override;
 
         void select() override;
     };
@@ -105,8 +160,7 @@ namespace gui
         TextBox(Window& window, double posX, double posY, double width,
             double height);
         std::string textBuffer;
-        void draw() override;
-        void draw(bool highlight);
+        void render() override;
         BLRgba32 bgColor = BLRgba32(0xff000000);
         BLRgba32 highlightColor = BLRgba32(0xff404040);
         BLRgba32 borderColor = BLRgba32(0xffffffff);
@@ -115,58 +169,161 @@ namespace gui
         void select() override;
         void writeChar(char input);
         void eraseChar();
+        // replaces the last word with the first of candidates(word), or on
+        // a repeated call with the next one
+        void complete(const std::function<std::vector<std::string>(
+            std::string_view word)>& candidates);
+    private:
+        std::vector<std::string> completions;
+        size_t completionIndex = 0;
+        size_t completionStart = 0;
+        // the buffer's size after the last completion, to tell a repeat
+        size_t completedSize = 0;
+    };
+
+    // the nicks in a channel, ordered by prefix rank and then name. only the
+    // rows in view are drawn, so a frame costs the same however many
+    // members the channel has
+    class MemberList : public Widget
+    {
+    public:
+        struct Row
+        {
+            irc::Atom nick;
+            // mode prefix such as '@' or '+', 0 for none
+            char prefix;
+            // position of the prefix among the network's, lower first
+            uint8_t rank;
+        };
+
+    private:
+        // the network the nicks are atoms of, whose casemapping orders and
+        // matches them
+        const irc::AtomTable* atoms = nullptr;
+        irc::CaseMapping sortedMapping = irc::CaseMapping::RFC1459;
+        // sorted by rank, then by folded nick
+        std::vector<Row> rows;
+        // nicks that spoke in the channel lately, most recent first
+        std::vector<irc::Atom> speakers;
+        // rows scrolled past the top
+        size_t topRow = 0;
+        bool before(const Row& a, const Row& b) const;
+        bool same(irc::Atom a, irc::Atom b) const;
+        // resorts the rows if the network's casemapping changed under them
+        void keepOrder();
+        // index of the row for nick, or rows.size(); a binary search in
+        // each rank
+        size_t find(irc::Atom nick) const;
+        size_t insert(Row row);
+        // keeps the rows in view still when one comes or goes above them
+        void inserted(size_t index);
+        void removed(size_t index);
+        void redraw();
+        size_t visibleRows() const;
+    public:
+        MemberList(Window& window, double posX, double posY, double width,
+            double height);
+        BLRgba32 bgColor = BLRgba32(0xff000000);
+        BLRgba32 borderColor = BLRgba32(0xffffffff);
+        BLRgba32 textColor = BLRgba32(0xffffffff);
+        // set while its channel is the active tab
+        bool shown = false;
+
+        void render() override;
+        // empties the list for a channel of the network with these atoms
+        void reset(const irc::AtomTable& atoms);
+        // replaces every row, e.g. once a NAMES listing ends
+        void assign(std::vector<Row> rows);
+        void add(irc::Atom nick, char prefix, uint8_t rank);
+        void remove(irc::Atom nick);
+        void rename(irc::Atom from, irc::Atom to);
+        void scroll(double distance);
+        size_t size() const;
+        // moves nick to the front of the recent speakers
+        void spoke(irc::Atom nick);
+        // up to limit nicks starting with prefix under the network's
+        // casemapping; recent speakers first, then the rest by name
+        std::vector<std::string> complete(std::string_view prefix,
+            size_t limit);
     };
 
     class MessageDisplay : public Widget
     {
-        std::vector<log_item::LogItem> messages;
+        Scrollback messages;
         double nickPosX = 0;
         double msgPosX = 0;
+
+        // messages wrapped under another generation are rewrapped when next
+        // drawn; it moves on whenever the width, font or columns change
+        uint32_t layoutGeneration = 1;
+        double layoutWidth = 0;
+        BLUniqueId layoutFace = 0;
+        float layoutFontSize = 0;
+        void updateColumns(const Scrollback::Item& item);
+        void relayout();
+        // the item's nick from the network's atoms, or the sender it was
+        // logged with
+        std::string_view nickOf(const Scrollback::Item& item) const;
+
+        // wrapped line counts of the items above, exact for every item drawn
+        // under the current layout and an estimate for the rest
+        LineIndex lineIndex;
+        // pixels scrolled from the top of the log, pinned to the bottom
+        // while following
+        double scrollTop = 0;
+        bool following = true;
+        uint32_t measureItem(size_t item, const double* spaceWidth);
+        double maxScroll() const;
     public:
-        double scrollPercent = 1;
+        static constexpr double textInset = 10;
+        // set while this is the active tab's display
+        bool shown = false;
+        // the network the logged nicks are atoms of, none for the global tab
+        const irc::AtomTable* atoms = nullptr;
+        // the channel's nicks, docked along the right edge when the display
+        // is given room for them
+        MemberList memberList;
         MessageDisplay(Window& window, double posX, double posY, double width,
-            double height);
+            double height, double membersWidth = 0);
         BLRgba32 bgColor = BLRgba32(0xff000000);
         BLRgba32 highlightColor = BLRgba32(0xff404040);
         BLRgba32 borderColor = BLRgba32(0xffffffff);
         BLRgba32 textColor = BLRgba32(0xffffffff);
 
         void draw() override;
-        void logMessage(log_item::LogItem&& logItem);
+        void render() override;
+        void logMessage(const log_item::LogItem& logItem);
         void scroll(double distance);
+        // gives back what memory it can, for when the system runs low
+        void trim();
 
-        void formatMessage(
-            log_item::Message* message,
-            int* nLines,
-            int* nNewlines,
-            const double* maxMessagesVisible,
-            const double* offsetXText,
-            const double* spaceWidth,
-            int* offsetYTest,
-            const double* lineHeight
+        // wraps the message if the layout changed, returns its line count
+        uint32_t formatMessage(
+            const Scrollback::Item& message,
+            const double* spaceWidth
         );
 
-        void drawItem(
-            log_item::FormattedMessage* message,
+        void drawMessage(
+            const Scrollback::Item& message,
             double* offsetY,
-            const double* wrapOverflowShift,
+            const double* scrollTop,
             const double* offsetX,
             const double* lineHeight
         );
 
-        void drawItem(
-            const log_item::Join* join,
+        void drawJoin(
+            const Scrollback::Item& join,
             const double* offsetX,
             double* offsetY,
-            const double* wrapOverflowShift,
+            const double* scrollTop,
             const double* lineHeight
         );
 
-        void drawItem(
-            const log_item::Part* part,
+        void drawPart(
+            const Scrollback::Item& part,
             const double* offsetX,
             double* offsetY,
-            const double* wrapOverflowShift,
+            const double* scrollTop,
             const double* lineHeight
         );
     };
@@ -175,16 +332,18 @@ namespace gui
     {
         double tabHeight;
         std::string name;
+        ChannelKey key;
         TabBar& tabBar;
     public:
         const std::string& getName{name};
+        const ChannelKey& getKey{key};
         BLRgba32 bgColor{BLRgba32(0xff353652)};
         BLRgba32 borderColor{BLRgba32(0xff686881)};
         BLRgba32 textColor{BLRgba32(0xffffffff)};
         BLRgba32 activeColor{BLRgba32(0xff454662)};
         Tab(Window& window, double posX, double posY, double width, double
-            height, std::string name, TabBar& tabBar);
-        void draw() override;
+            height, std::string name, ChannelKey key, TabBar& tabBar);
+        void render() override;
         void select() override;
     };
 
@@ -193,18 +352,27 @@ namespace gui
         double tabX{posX + 5};
     public:
         std::pair<std::unique_ptr<Tab>, MessageDisplay>* activeTab = nullptr;
-        std::unordered_map<std::string, std::pair<std::unique_ptr<Tab>,
+        static constexpr ChannelKey globalKey = 0;
+        std::unordered_map<ChannelKey, std::pair<std::unique_ptr<Tab>,
             MessageDisplay>> messageDisplays;
         TabBar(Window& window, double posX, double posY, double width, double
             height);
 
         void draw() override;
-        void addChannel(const std::string& name);
-        void closeTab(const std::string& channel);
+        void setActiveTab(std::pair<std::unique_ptr<Tab>, MessageDisplay>* tab);
+        void addChannel(ChannelKey key, const std::string& name);
+        // the network's open channels starting with prefix, folded by the
+        // network's casemapping, by name
+        std::vector<std::string> completeChannel(std::string_view prefix,
+            uint32_t network, irc::CaseMapping caseMapping) const;
+        void closeTab(ChannelKey key);
     };
 
     inline BLFont blFont;
     inline BLFontFace blFontFace;
+    inline bool fontReady = false;
+    // 4 MiB of shaped text
+    inline GlyphCache glyphCache{4 << 20};
 
     char readChar(const SDL_Event& event, bool shiftKey);
 }
@@ -0,0 +1,94 @@
+#include "glyph_cache.hpp"
+#include <functional>
+
+using namespace gui;
+
+// glyph id, placement and cluster for each glyph, roughly
+#define BYTES_PER_GLYPH 32
+
+const BLGlyphRun& GlyphCache::ShapedText::glyphRun() const
+{
+    return glyphs.glyphRun();
+}
+
+double GlyphCache::ShapedText::advance() const
+{
+    return metrics.advance.x;
+}
+
+size_t GlyphCache::KeyHash::operator()(const Key& key) const
+{
+    size_t hash = std::hash<std::string_view>()(key.text);
+    hash ^= std::hash<uint64_t>()(key.face) + 0x9e3779b97f4a7c15
+        + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<float>()(key.size) + 0x9e3779b97f4a7c15
+        + (hash << 6) + (hash >> 2);
+
+    return hash;
+}
+
+GlyphCache::GlyphCache(size_t maxBytes) : maxBytes(maxBytes) { }
+
+const GlyphCache::ShapedText& GlyphCache::get(const BLFont& font,
+    std::string_view text)
+{
+    Key key{font.face().uniqueId(), font.size(), text};
+    auto found = index.find(key);
+
+    if (found != index.end())
+    {
+        ++hits;
+        entries.splice(entries.begin(), entries, found->second);
+
+        return found->second->shaped;
+    }
+
+    ++misses;
+
+    Entry& entry = entries.emplace_front();
+    entry.face = key.face;
+    entry.size = key.size;
+    entry.text = text;
+    entry.shaped.glyphs.setUtf8Text(entry.text.data(), entry.text.size());
+    font.shape(entry.shaped.glyphs);
+    font.getTextMetrics(entry.shaped.glyphs, entry.shaped.metrics);
+    entry.bytes = sizeof(Entry) + entry.text.size()
+        + entry.shaped.glyphs.size() * BYTES_PER_GLYPH;
+
+    bytes += entry.bytes;
+    index.emplace(Key{entry.face, entry.size, entry.text}, entries.begin());
+    evict();
+
+    return entry.shaped;
+}
+
+void GlyphCache::setMaxBytes(size_t maxBytes)
+{
+    this->maxBytes = maxBytes;
+    evict();
+}
+
+void GlyphCache::clear()
+{
+    index.clear();
+    entries.clear();
+    bytes = 0;
+}
+
+GlyphCache::Stats GlyphCache::getStats() const
+{
+    return Stats{hits, misses, evictions, entries.size(), bytes};
+}
+
+void GlyphCache::evict()
+{
+    // the newest entry stays even when it alone is over the cap
+    while (bytes > maxBytes && entries.size() > 1)
+    {
+        Entry& oldest = entries.back();
+        index.erase(Key{oldest.face, oldest.size, oldest.text});
+        bytes -= oldest.bytes;
+        entries.pop_back();
+        ++evictions;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <blend2d.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace gui
+{
+    // shaped text shared by every widget, keyed by font and string. the
+    // least recently used runs are dropped once their estimated size
+    // passes the cap
+    class GlyphCache
+    {
+    public:
+        struct ShapedText
+        {
+            BLGlyphBuffer glyphs;
+            BLTextMetrics metrics;
+
+            const BLGlyphRun& glyphRun() const;
+            double advance() const;
+        };
+
+        struct Stats
+        {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t evictions = 0;
+            size_t entries = 0;
+            size_t bytes = 0;
+        };
+
+        explicit GlyphCache(size_t maxBytes);
+
+        // the result stays valid until a later get() evicts it
+        const ShapedText& get(const BLFont& font, std::string_view text);
+        void setMaxBytes(size_t maxBytes);
+        void clear();
+        Stats getStats() const;
+
+    private:
+        struct Entry
+        {
+            BLUniqueId face;
+            float size;
+            std::string text;
+            ShapedText shaped;
+            size_t bytes;
+        };
+
+        // views into the entry's own text, so lookups need no copy
+        struct Key
+        {
+            BLUniqueId face;
+            float size;
+            std::string_view text;
+
+            bool operator==(const Key& other) const = default;
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const;
+        };
+
+        // most recently used at the front
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        size_t maxBytes;
+        size_t bytes = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+
+        void evict();
+    };
+}
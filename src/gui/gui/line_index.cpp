@@ -0,0 +1,105 @@
+#include "line_index.hpp"
+
+using namespace gui;
+
+namespace
+{
+    size_t lowbit(size_t i)
+    {
+        return i & -i;
+    }
+}
+
+void LineIndex::push(uint32_t lines)
+{
+    size_t node = counts.size() + 1;
+    uint64_t covered = lines;
+
+    // the new node also covers the nodes it spans below it
+    for (size_t child = node - 1; child > node - lowbit(node);
+        child -= lowbit(child))
+    {
+        covered += tree[child - 1];
+    }
+
+    counts.push_back(lines);
+    tree.push_back(covered);
+    sum += lines;
+}
+
+void LineIndex::set(size_t item, uint32_t lines)
+{
+    // unsigned wraparound carries a negative change through the sums
+    uint64_t change = static_cast<uint64_t>(lines) - counts[item];
+
+    if (!change)
+    {
+        return;
+    }
+
+    counts[item] = lines;
+    sum += change;
+
+    for (size_t node = item + 1; node <= tree.size(); node += lowbit(node))
+    {
+        tree[node - 1] += change;
+    }
+}
+
+uint32_t LineIndex::lines(size_t item) const
+{
+    return counts[item];
+}
+
+uint64_t LineIndex::linesBefore(size_t item) const
+{
+    uint64_t before = 0;
+
+    for (size_t node = item; node > 0; node -= lowbit(node))
+    {
+        before += tree[node - 1];
+    }
+
+    return before;
+}
+
+uint64_t LineIndex::total() const
+{
+    return sum;
+}
+
+size_t LineIndex::itemAt(uint64_t line) const
+{
+    size_t step = 1;
+    size_t item = 0;
+
+    while (step * 2 <= tree.size())
+    {
+        step *= 2;
+    }
+
+    // descend from the widest node, skipping every node that ends at or
+    // before the line
+    for (; step; step /= 2)
+    {
+        if (item + step <= tree.size() && tree[item + step - 1] <= line)
+        {
+            item += step;
+            line -= tree[item - 1];
+        }
+    }
+
+    return item;
+}
+
+size_t LineIndex::size() const
+{
+    return counts.size();
+}
+
+void LineIndex::clear()
+{
+    counts.clear();
+    tree.clear();
+    sum = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gui
+{
+    // wrapped line count of every log item with prefix sums over them, so
+    // the item at a scroll position and the position of an item are found
+    // in O(log n) however long the log grows
+    class LineIndex
+    {
+    public:
+        void push(uint32_t lines);
+        void set(size_t item, uint32_t lines);
+        uint32_t lines(size_t item) const;
+
+        // lines taken by the items before the given one
+        uint64_t linesBefore(size_t item) const;
+        uint64_t total() const;
+        // the item the given line falls in, size() when past the end
+        size_t itemAt(uint64_t line) const;
+
+        size_t size() const;
+        void clear();
+
+    private:
+        std::vector<uint32_t> counts;
+        // fenwick tree, node i holds the sum of counts over
+        // (i - lowbit(i), i], stored one-based at tree[i - 1]
+        std::vector<uint64_t> tree;
+        uint64_t sum = 0;
+    };
+}
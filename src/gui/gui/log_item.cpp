@@ -1,43 +1,47 @@
 #include "log_item.hpp"
 #include "../gui.hpp"
-#include <sstream>
-#include <string>
+#include <algorithm>
+#include <string_view>
+#include <vector>
 #include <blend2d.h>
 
 using namespace gui;
 using namespace gui::log_item;
 
-void MessageDisplay::formatMessage(
-    Message* message,
-    int* nLines,
-    int* nNewlines,
-    const double* maxMessagesVisible,
-    const double* offsetXText,
-    const double* spaceWidth,
-    int* offsetYTest,
-    const double* lineHeight
-) {
-    BLGlyphBuffer glyphBuffer;
-    BLTextMetrics textMetrics;
-
-    // format time logged
-    tm* timeInfo = localtime(&message->timeLogged);
-    message->formatted.timeLogged =
-        '['
-        + std::to_string(timeInfo->tm_hour)
-        + ':'
-        + std::to_string(timeInfo->tm_min)
-        + ':'
-        + std::to_string(timeInfo->tm_sec)
-        + ']';
-    blFont.shape(glyphBuffer);
-    glyphBuffer.setUtf8Text(message->formatted.timeLogged.c_str());
-    blFont.getTextMetrics(glyphBuffer, textMetrics);
+namespace
+{
+    // nick enclosed in angle brackets, drawn as three cached runs so no
+    // label is built per message
+    double nickLabelAdvance(std::string_view nick)
+    {
+        return glyphCache.get(blFont, "<").advance()
+            + glyphCache.get(blFont, nick).advance()
+            + glyphCache.get(blFont, ">").advance();
+    }
+}
 
+std::string_view MessageDisplay::nickOf(const Scrollback::Item& item) const
+{
+    if (item.record.nick == irc::NO_ATOM || !atoms)
+    {
+        return item.sender;
+    }
+
+    return atoms->name(item.record.nick);
+}
+
+void MessageDisplay::relayout()
+{
+    ++layoutGeneration;
+    messages.clearBreaks();
+}
+
+void MessageDisplay::updateColumns(const Scrollback::Item& item)
+{
     double nextPosXCandidate {
         posX
-        + *offsetXText
-        + textMetrics.advance.x
+        + textInset
+        + glyphCache.get(blFont, item.timeLabel).advance()
         + 10.f
     };
 
@@ -45,107 +49,123 @@ void MessageDisplay::formatMessage(
     if (nextPosXCandidate > nickPosX)
     {
         nickPosX = nextPosXCandidate;
+        relayout();
     }
     else
     {
         nextPosXCandidate = nickPosX;
     }
 
-    // enclose nick in angle brackets
-    message->formatted.nick = std::string('<' + message->nick + '>');
-    glyphBuffer.setUtf8Text(message->formatted.nick.c_str());
-    blFont.getTextMetrics(glyphBuffer, textMetrics);
-
-    nextPosXCandidate += textMetrics.advance.x + 10;
+    nextPosXCandidate += nickLabelAdvance(nickOf(item))
+        + 10;
 
     // update message column x position
     if (nextPosXCandidate > msgPosX)
     {
         msgPosX = nextPosXCandidate;
+        relayout();
     }
+}
 
-    std::string word;
-    std::stringstream ss(message->rawMessage);
-
-    double nextWordPosX { msgPosX + textMetrics.advance.x + *spaceWidth };
-    int msgIndex = 0;
-    int lastMsgIndex = 0;
-    ++(*nLines);
-
-    // re-initialize stringstream to reset std::getline
-    ss.str(message->rawMessage);
-
-    // clear message lines from previous call to this method
-    message->formatted.messageLines.clear();
-
-    // for every word in single-line message
-    while (std::getline(ss, word, ' '))
+uint32_t MessageDisplay::formatMessage(
+    const Scrollback::Item& message,
+    const double* spaceWidth
+) {
+    // wrap only when the layout moved on since this message was last wrapped
+    if (message.layout.generation != layoutGeneration)
     {
-        glyphBuffer.setUtf8Text(word.c_str());
-        blFont.getTextMetrics(glyphBuffer, textMetrics);
-        nextWordPosX += textMetrics.advance.x + *spaceWidth;
-
-        // if word reaches right side of message display
-        if (nextWordPosX >= posX + width - 5)
+        std::string_view rawMessage { message.text };
+        double nextWordPosX {
+            msgPosX
+            + nickLabelAdvance(nickOf(message))
+            + *spaceWidth
+        };
+        size_t lineStart = 0;
+        std::vector<uint32_t> lineStarts;
+
+        // for every word in single-line message
+        for (size_t wordStart = 0; wordStart < rawMessage.size();)
         {
-            ++(*nLines);
-            ++(*nNewlines);
-
-            // add line to formatted message
-            message->formatted.messageLines.emplace_back(
-                message->rawMessage.substr(
-                    lastMsgIndex,
-                    msgIndex - lastMsgIndex - 1
-                )
-            );
-            lastMsgIndex = msgIndex;
-
-            // set next word coordinates to start of new line
-            *offsetYTest += *lineHeight;
-            nextWordPosX = msgPosX;
+            size_t wordEnd {
+                std::min(rawMessage.find(' ', wordStart), rawMessage.size())
+            };
+
+            const double wordWidth {
+                glyphCache.get(blFont, rawMessage.substr(wordStart,
+                    wordEnd - wordStart)).advance() + *spaceWidth
+            };
+            nextWordPosX += wordWidth;
+
+            // if word reaches right side of message display, it starts the
+            // next line unless it is alone on this one
+            if (nextWordPosX >= posX + width - 5 && wordStart > lineStart)
+            {
+                lineStarts.push_back(wordStart);
+                lineStart = wordStart;
+                nextWordPosX = msgPosX + wordWidth;
+            }
+
+            wordStart = wordEnd + 1;
         }
 
-        msgIndex += word.length() + 1;
+        messages.setBreaks(message.layout, layoutGeneration, lineStarts);
     }
 
-    // add final line to formatted message
-    message->formatted.messageLines.emplace_back(
-        message->rawMessage.substr(lastMsgIndex)
-    );
-
-    *offsetYTest += *lineHeight;
+    return message.layout.breakCount + 1;
 }
 
-void gui::MessageDisplay::drawItem(
-    FormattedMessage* message,
+void gui::MessageDisplay::drawMessage(
+    const Scrollback::Item& message,
     double* offsetY,
-    const double* wrapOverflowShift,
+    const double* scrollTop,
     const double* offsetX,
     const double* lineHeight
 ) {
-    double printY { posY + *offsetY - *wrapOverflowShift };
+    const std::span<const uint32_t> lineStarts {
+        messages.breaks(message.layout)
+    };
+    const std::string_view rawMessage { message.text };
+    double printY { posY + *offsetY - *scrollTop };
 
     // draw time logged
-    window.blContext.fillUtf8Text(
+    canvas().fillGlyphRun(
         BLPoint(posX + *offsetX, printY),
         blFont,
-        message->timeLogged.data()
+        glyphCache.get(blFont, message.timeLabel).glyphRun()
     );
 
     // draw nick
-    window.blContext.fillUtf8Text(
-        BLPoint(nickPosX, printY),
-        blFont,
-        message->nick.data()
-    );
+    double nickX { nickPosX };
 
-    // draw each message line
-    for (std::string& messageLine : message->messageLines)
+    for (std::string_view part : { std::string_view("<"),
+        nickOf(message), std::string_view(">") })
     {
-        window.blContext.fillUtf8Text(
+        const GlyphCache::ShapedText& shaped { glyphCache.get(blFont, part) };
+
+        canvas().fillGlyphRun(
+            BLPoint(nickX, printY),
+            blFont,
+            shaped.glyphRun()
+        );
+
+        nickX += shaped.advance();
+    }
+
+    // draw each message line, ending before the space it wrapped at
+    for (size_t line = 0; line <= lineStarts.size(); ++line)
+    {
+        size_t lineStart { line ? lineStarts[line - 1] : 0 };
+        size_t lineEnd {
+            line < lineStarts.size()
+                ? lineStarts[line] - 1
+                : rawMessage.size()
+        };
+
+        canvas().fillGlyphRun(
             BLPoint(msgPosX, printY),
             blFont,
-            messageLine.data()
+            glyphCache.get(blFont, rawMessage.substr(lineStart,
+                lineEnd - lineStart)).glyphRun()
         );
 
         printY += *lineHeight;
@@ -153,15 +173,15 @@ void gui::MessageDisplay::drawItem(
     }
 }
 
-void gui::MessageDisplay::drawItem(
-    const Join* join,
+void gui::MessageDisplay::drawJoin(
+    const Scrollback::Item& join,
     const double* offsetX,
     double* offsetY,
-    const double* wrapOverflowShift,
+    const double* scrollTop,
     const double* lineHeight
 ) {
     const double textHeight { blFont.metrics().ascent };
-    const double drawY { posY + *offsetY - textHeight + 3 };
+    const double drawY { posY + *offsetY - *scrollTop - textHeight + 3 };
     const double drawX { posX + *offsetX };
 
     const BLPoint leftArrow[] = {
@@ -174,31 +194,31 @@ void gui::MessageDisplay::drawItem(
         BLPoint(drawX + 8, drawY + textHeight)
     };
 
-    window.blContext.fillPolygon(
+    canvas().fillPolygon(
         leftArrow,
         sizeof(leftArrow) / sizeof(BLPoint)
     );
 
-    window.blContext.fillUtf8Text(
-        BLPoint(drawX + 25, posY + *offsetY - *wrapOverflowShift),
+    canvas().fillGlyphRun(
+        BLPoint(drawX + 25, posY + *offsetY - *scrollTop),
         blFont,
-        join->user.c_str()
+        glyphCache.get(blFont, nickOf(join)).glyphRun()
     );
 
     *offsetY += *lineHeight;
 }
 
-void gui::MessageDisplay::drawItem(
-    const Part* part,
+void gui::MessageDisplay::drawPart(
+    const Scrollback::Item& part,
     const double* offsetX,
     double* offsetY,
-    const double* wrapOverflowShift,
+    const double* scrollTop,
     const double* lineHeight
 ) {
     const double textHeight { blFont.metrics().ascent };
-    const double drawY { posY + *offsetY - textHeight + 3 };
+    const double drawY { posY + *offsetY - *scrollTop - textHeight + 3 };
     const double drawX { posX + *offsetX };
-    const double textY { posY + *offsetY - *wrapOverflowShift };
+    const double textY { posY + *offsetY - *scrollTop };
 
     const BLPoint rightArrow[] = {
         BLPoint(drawX + 20, drawY + textHeight / 2),
@@ -210,39 +230,37 @@ void gui::MessageDisplay::drawItem(
         BLPoint(drawX + 12, drawY + textHeight)
     };
 
-    window.blContext.fillPolygon(
+    canvas().fillPolygon(
         rightArrow,
         sizeof(rightArrow) / sizeof(BLPoint)
     );
 
     const double nickPosX { drawX + 25 };
 
-    window.blContext.fillUtf8Text(
+    const GlyphCache::ShapedText& user { glyphCache.get(blFont,
+        nickOf(part)) };
+    const double userWidth { user.advance() };
+
+    canvas().fillGlyphRun(
         BLPoint(nickPosX, textY),
         blFont,
-        part->user.c_str()
+        user.glyphRun()
     );
 
-    if (part->message.has_value())
+    if (part.record.hasText)
     {
-        BLTextMetrics textMetrics;
-        BLGlyphBuffer glyphBuffer;
-        blFont.shape(glyphBuffer);
-        glyphBuffer.setUtf8Text(part->user.c_str());
-        blFont.getTextMetrics(glyphBuffer, textMetrics);
-
-        window.blContext.setStrokeWidth(2);
+        canvas().setStrokeWidth(2);
 
-        window.blContext.strokeLine(
-            BLPoint(nickPosX + textMetrics.advance.x + 7, drawY),
-            BLPoint(nickPosX + textMetrics.advance.x + 7, drawY + textHeight),
+        canvas().strokeLine(
+            BLPoint(nickPosX + userWidth + 7, drawY),
+            BLPoint(nickPosX + userWidth + 7, drawY + textHeight),
             textColor
         );
 
-        window.blContext.fillUtf8Text(
-            BLPoint(nickPosX + textMetrics.advance.x + 13, textY),
+        canvas().fillGlyphRun(
+            BLPoint(nickPosX + userWidth + 13, textY),
             blFont,
-            part->message.value().c_str()
+            glyphCache.get(blFont, part.text).glyphRun()
         );
     }
 
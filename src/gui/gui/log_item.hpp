@@ -1,10 +1,10 @@
 #pragma once
 
 #include <optional>
-#include <string>
+#include <string_view>
 #include <ctime>
 #include <variant>
-#include <vector>
+#include "../../irc/atom_table.hpp"
 
 namespace gui
 {
@@ -17,30 +17,28 @@ namespace gui
             PART,
         };
 
-        struct FormattedMessage
-        {
-            std::string timeLogged;
-            std::string nick;
-            std::vector<std::string> messageLines;
-        };
+        // views of the caller's text, copied into the display's log by
+        // logMessage. nicks are atoms of the display's network
 
         struct Message
         {
             std::time_t timeLogged;
-            std::string nick;
-            std::string rawMessage;
-            FormattedMessage formatted;
+            irc::Atom nick;
+            std::string_view rawMessage;
+            // shown in place of the nick when it is irc::NO_ATOM, e.g. "*"
+            // for notices or a server's host
+            std::string_view sender = {};
         };
 
         struct Join
         {
-            std::string user;
+            irc::Atom user;
         };
 
         struct Part
         {
-            std::string user;
-            std::optional<std::string> message;
+            irc::Atom user;
+            std::optional<std::string_view> message;
         };
 
         typedef std::variant<Message, Join, Part> LogItem;
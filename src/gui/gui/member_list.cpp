@@ -0,0 +1,426 @@
+#include "../gui.hpp"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <blend2d.h>
+
+#define RECENT_SPEAKERS 50
+
+using namespace gui;
+
+namespace
+{
+    bool lessFolded(std::string_view a, std::string_view b,
+        irc::CaseMapping caseMapping)
+    {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(),
+            b.end(), [&](char x, char y)
+            {
+                return irc::foldCase(x, caseMapping)
+                    < irc::foldCase(y, caseMapping);
+            });
+    }
+
+    bool startsFolded(std::string_view text, std::string_view prefix,
+        irc::CaseMapping caseMapping)
+    {
+        return text.size() >= prefix.size() && std::equal(prefix.begin(),
+            prefix.end(), text.begin(), [&](char x, char y)
+            {
+                return irc::foldCase(x, caseMapping)
+                    == irc::foldCase(y, caseMapping);
+            });
+    }
+}
+
+MemberList::MemberList(Window& window, double posX, double posY, double width,
+    double height)
+    : Widget(window, posX, posY, width, height) { }
+
+void MemberList::render()
+{
+    BLRoundRect roundRect(posX, posY, width, height, 5);
+    canvas().fillRoundRect(roundRect, bgColor);
+    canvas().setStrokeWidth(1.f);
+    canvas().strokeRoundRect(roundRect, borderColor);
+
+    keepOrder();
+
+    const double lineHeight = blFont.size() + 2;
+    const size_t visible = visibleRows();
+
+    // rows may have left since the list was scrolled
+    topRow = std::min(topRow, rows.size() - std::min(rows.size(), visible));
+
+    canvas().setFillStyle(textColor);
+    canvas().clipToRect(BLRect(posX, posY, width, height));
+
+    // prefixes share one narrow column to the left of the nicks
+    const double prefixX = posX + 5;
+    const double nickX = prefixX + glyphCache.get(blFont, "@").advance() + 2;
+    const size_t endRow = std::min(rows.size(), topRow + visible + 1);
+
+    for (size_t row = topRow; row < endRow; ++row)
+    {
+        const double printY = posY + (row - topRow + 1) * lineHeight;
+
+        if (rows[row].prefix)
+        {
+            canvas().fillGlyphRun(
+                BLPoint(prefixX, printY),
+                blFont,
+                glyphCache.get(blFont,
+                    std::string_view(&rows[row].prefix, 1)).glyphRun()
+            );
+        }
+
+        canvas().fillGlyphRun(
+            BLPoint(nickX, printY),
+            blFont,
+            glyphCache.get(blFont, atoms->name(rows[row].nick)).glyphRun()
+        );
+    }
+
+    if (rows.size() > visible && visible)
+    {
+        const double bottom = rows.size() - visible;
+        double scrollbarLen = std::max(height * visible / rows.size(), 10.0);
+        double scrollPosY = posY + topRow / bottom * (height - scrollbarLen);
+        BLLine scrollLine(posX + width - 7, scrollPosY, posX + width - 7,
+            scrollPosY + scrollbarLen);
+        canvas().setStrokeWidth(5);
+        canvas().strokeLine(scrollLine, textColor);
+    }
+
+    canvas().restoreClipping();
+}
+
+void MemberList::reset(const irc::AtomTable& atoms)
+{
+    this->atoms = &atoms;
+    sortedMapping = atoms.getCaseMapping();
+    rows.clear();
+    speakers.clear();
+    topRow = 0;
+    redraw();
+}
+
+void MemberList::assign(std::vector<Row> rows)
+{
+    if (!atoms)
+    {
+        return;
+    }
+
+    sortedMapping = atoms->getCaseMapping();
+    std::sort(rows.begin(), rows.end(),
+        [&](const Row& a, const Row& b) { return before(a, b); });
+    this->rows = std::move(rows);
+    topRow = 0;
+    redraw();
+}
+
+void MemberList::add(irc::Atom nick, char prefix, uint8_t rank)
+{
+    if (!atoms)
+    {
+        return;
+    }
+
+    keepOrder();
+
+    // already listed by a NAMES reply that crossed the JOIN
+    if (find(nick) != rows.size())
+    {
+        return;
+    }
+
+    inserted(insert(Row { nick, prefix, rank }));
+}
+
+void MemberList::remove(irc::Atom nick)
+{
+    keepOrder();
+    size_t index = find(nick);
+
+    if (index == rows.size())
+    {
+        return;
+    }
+
+    rows.erase(rows.begin() + index);
+    removed(index);
+
+    auto speaker = std::find_if(speakers.begin(), speakers.end(),
+        [&](irc::Atom speaker) { return same(speaker, nick); });
+
+    if (speaker != speakers.end())
+    {
+        speakers.erase(speaker);
+    }
+}
+
+void MemberList::rename(irc::Atom from, irc::Atom to)
+{
+    keepOrder();
+    size_t index = find(from);
+
+    if (index == rows.size())
+    {
+        return;
+    }
+
+    Row row = rows[index];
+    rows.erase(rows.begin() + index);
+    removed(index);
+
+    row.nick = to;
+    inserted(insert(row));
+
+    for (irc::Atom& speaker : speakers)
+    {
+        if (same(speaker, from))
+        {
+            speaker = to;
+        }
+    }
+}
+
+void MemberList::scroll(double distance)
+{
+    const double lineHeight = blFont.size() + 2;
+    const size_t visible = visibleRows();
+
+    if (rows.size() <= visible)
+    {
+        return;
+    }
+
+    // whole rows, at least one per step
+    double step = std::round(distance / lineHeight);
+    if (step == 0)
+    {
+        step = distance < 0 ? -1 : 1;
+    }
+
+    topRow = static_cast<size_t>(std::clamp(static_cast<double>(topRow) + step,
+        0.0, static_cast<double>(rows.size() - visible)));
+    invalidate();
+}
+
+size_t MemberList::size() const
+{
+    return rows.size();
+}
+
+void MemberList::spoke(irc::Atom nick)
+{
+    if (!atoms)
+    {
+        return;
+    }
+
+    auto speaker = std::find_if(speakers.begin(), speakers.end(),
+        [&](irc::Atom speaker) { return same(speaker, nick); });
+
+    if (speaker == speakers.end())
+    {
+        if (speakers.size() < RECENT_SPEAKERS)
+        {
+            speakers.emplace_back();
+        }
+
+        speaker = speakers.end() - 1;
+        *speaker = nick;
+    }
+
+    std::rotate(speakers.begin(), speaker, speaker + 1);
+}
+
+std::vector<std::string> MemberList::complete(std::string_view prefix,
+    size_t limit)
+{
+    std::vector<std::string> found;
+
+    if (!atoms)
+    {
+        return found;
+    }
+
+    keepOrder();
+
+    for (irc::Atom speaker : speakers)
+    {
+        if (found.size() < limit
+            && startsFolded(atoms->name(speaker), prefix, sortedMapping))
+        {
+            found.emplace_back(atoms->name(speaker));
+        }
+    }
+
+    const size_t recent = found.size();
+
+    // the matches in each rank are one run of rows; merge the runs by name
+    // and stop at the limit, however many members match
+    std::vector<std::pair<std::vector<Row>::const_iterator,
+        std::vector<Row>::const_iterator>> runs;
+
+    for (auto bucket = rows.cbegin(); bucket != rows.cend();)
+    {
+        const uint8_t rank = bucket->rank;
+        auto bucketEnd = std::partition_point(bucket, rows.cend(),
+            [&](const Row& row) { return row.rank == rank; });
+
+        auto first = std::lower_bound(bucket, bucketEnd, prefix,
+            [&](const Row& row, std::string_view prefix)
+            {
+                return lessFolded(atoms->name(row.nick), prefix,
+                    sortedMapping);
+            });
+
+        if (first != bucketEnd
+            && startsFolded(atoms->name(first->nick), prefix, sortedMapping))
+        {
+            runs.emplace_back(first, bucketEnd);
+        }
+
+        bucket = bucketEnd;
+    }
+
+    while (found.size() < limit && !runs.empty())
+    {
+        auto next = std::min_element(runs.begin(), runs.end(),
+            [&](const auto& a, const auto& b)
+            {
+                return lessFolded(atoms->name(a.first->nick),
+                    atoms->name(b.first->nick), sortedMapping);
+            });
+
+        const std::string_view nick = atoms->name(next->first->nick);
+
+        if (std::find_if(found.begin(), found.begin() + recent,
+            [&](const std::string& speaker)
+            { return atoms->equal(speaker, nick); }) == found.begin() + recent)
+        {
+            found.emplace_back(nick);
+        }
+
+        if (++next->first == next->second || !startsFolded(
+            atoms->name(next->first->nick), prefix, sortedMapping))
+        {
+            runs.erase(next);
+        }
+    }
+
+    return found;
+}
+
+bool MemberList::before(const Row& a, const Row& b) const
+{
+    return a.rank != b.rank ? a.rank < b.rank
+        : lessFolded(atoms->name(a.nick), atoms->name(b.nick), sortedMapping);
+}
+
+bool MemberList::same(irc::Atom a, irc::Atom b) const
+{
+    // a casemapping change can leave one name with two atoms
+    return a == b || atoms->equal(atoms->name(a), atoms->name(b));
+}
+
+void MemberList::keepOrder()
+{
+    if (!atoms || atoms->getCaseMapping() == sortedMapping)
+    {
+        return;
+    }
+
+    sortedMapping = atoms->getCaseMapping();
+    std::sort(rows.begin(), rows.end(),
+        [&](const Row& a, const Row& b) { return before(a, b); });
+    redraw();
+}
+
+size_t MemberList::find(irc::Atom nick) const
+{
+    if (rows.empty())
+    {
+        return 0;
+    }
+
+    const std::string_view name = atoms->name(nick);
+
+    // ranks are few, so this is a handful of binary searches
+    for (auto bucket = rows.begin(); bucket != rows.end();)
+    {
+        const uint8_t rank = bucket->rank;
+        auto bucketEnd = std::partition_point(bucket, rows.end(),
+            [&](const Row& row) { return row.rank == rank; });
+
+        auto found = std::lower_bound(bucket, bucketEnd, name,
+            [&](const Row& row, std::string_view name)
+            {
+                return lessFolded(atoms->name(row.nick), name,
+                    sortedMapping);
+            });
+
+        if (found != bucketEnd && same(found->nick, nick))
+        {
+            return found - rows.begin();
+        }
+
+        bucket = bucketEnd;
+    }
+
+    return rows.size();
+}
+
+size_t MemberList::insert(Row row)
+{
+    auto position = std::upper_bound(rows.begin(), rows.end(), row,
+        [&](const Row& a, const Row& b) { return before(a, b); });
+
+    return rows.insert(position, row) - rows.begin();
+}
+
+void MemberList::inserted(size_t index)
+{
+    if (index < topRow)
+    {
+        ++topRow;
+    }
+
+    redraw();
+}
+
+void MemberList::removed(size_t index)
+{
+    if (index < topRow)
+    {
+        --topRow;
+    }
+
+    redraw();
+}
+
+void MemberList::redraw()
+{
+    // lists in the background are rendered when they are switched to
+    if (shown)
+    {
+        invalidate();
+    }
+    else
+    {
+        layerStale = true;
+    }
+}
+
+size_t MemberList::visibleRows() const
+{
+    const double lineHeight = blFont.size() + 2;
+
+    // the last row keeps clear of the bottom border
+    return static_cast<size_t>(std::max((height - 5) / lineHeight, 0.0));
+}
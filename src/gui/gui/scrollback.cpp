@@ -0,0 +1,396 @@
+#include "scrollback.hpp"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace gui;
+using namespace gui::log_item;
+
+// kept in memory whatever the budget, about a screenful or two
+#define MIN_RESIDENT_ITEMS 256
+// segments held for scrolling back and forth across their edges
+#define MAX_PAGED_SEGMENTS 4
+// stale breaks tolerated on top of twice the live ones before compacting
+#define BREAK_SLACK 4096
+
+// segments are written as their records, then their text, padded so the
+// next segment's records stay aligned
+#define SEGMENT_ALIGN alignof(Scrollback::Record)
+
+namespace
+{
+    // the label's fields are unpadded, as they always were
+    void appendNumber(std::string& out, int value)
+    {
+        if (value >= 10)
+        {
+            out += static_cast<char>('0' + value / 10 % 10);
+        }
+
+        out += static_cast<char>('0' + value % 10);
+    }
+}
+
+Scrollback::Paged::Paged(FILE* file, size_t segment, const Segment& spilled)
+    : segment(segment)
+    , layouts(spilled.count)
+{
+    size_t length = spilled.count * sizeof(Record) + spilled.textLength;
+    const char* data = nullptr;
+
+    #ifndef _WIN32
+    // mappings start on a page boundary
+    long pageSize = sysconf(_SC_PAGESIZE);
+    long mapOffset = spilled.offset / pageSize * pageSize;
+    void* mapping = mmap(nullptr, length + (spilled.offset - mapOffset),
+        PROT_READ, MAP_PRIVATE, fileno(file), mapOffset);
+
+    if (mapping != MAP_FAILED)
+    {
+        mapped = mapping;
+        mapLength = length + (spilled.offset - mapOffset);
+        data = static_cast<const char*>(mapped) + (spilled.offset - mapOffset);
+    }
+    #endif
+
+    // no mapping, read the segment instead
+    if (!data)
+    {
+        bytes.resize(length);
+        std::fseek(file, spilled.offset, SEEK_SET);
+        std::fread(bytes.data(), 1, bytes.size(), file);
+        data = bytes.data();
+    }
+
+    records = reinterpret_cast<const Record*>(data);
+    text = data + spilled.count * sizeof(Record);
+}
+
+Scrollback::Paged::~Paged()
+{
+    #ifndef _WIN32
+    if (mapped)
+    {
+        munmap(mapped, mapLength);
+    }
+    #endif
+}
+
+Scrollback::Scrollback(size_t budget) : budget(budget) { }
+
+void Scrollback::push(const LogItem& logItem)
+{
+    Record record{0, static_cast<uint32_t>(text.size()), 0, irc::NO_ATOM,
+        static_cast<uint8_t>(logItem.index()), false, 0, 0};
+
+    if (const Message* message = std::get_if<Message>(&logItem))
+    {
+        record.timeLogged = message->timeLogged;
+        record.nick = message->nick;
+        record.hasText = true;
+
+        if (record.nick == irc::NO_ATOM)
+        {
+            std::string_view sender = message->sender.substr(0, UINT8_MAX);
+            record.senderLength = sender.size();
+            text += sender;
+        }
+
+        // formatted here so drawing and measuring never call localtime,
+        // and here only once a minute; zones are offset by whole minutes
+        std::time_t minute = message->timeLogged
+            - (message->timeLogged % 60 + 60) % 60;
+
+        if (minute != labelMinute)
+        {
+            tm* timeInfo = localtime(&minute);
+            labelMinute = minute;
+            labelHour = timeInfo->tm_hour;
+            labelMin = timeInfo->tm_min;
+        }
+
+        const size_t labelStart = text.size();
+        text += '[';
+        appendNumber(text, labelHour);
+        text += ':';
+        appendNumber(text, labelMin);
+        text += ':';
+        appendNumber(text, static_cast<int>(message->timeLogged - minute));
+        text += ']';
+        record.timeLength = text.size() - labelStart;
+        text += message->rawMessage;
+    }
+    else if (const Join* join = std::get_if<Join>(&logItem))
+    {
+        record.nick = join->user;
+    }
+    else if (const Part* part = std::get_if<Part>(&logItem))
+    {
+        record.nick = part->user;
+        record.hasText = part->message.has_value();
+        text += part->message.value_or("");
+    }
+
+    record.textLength = text.size() - record.textOffset - record.senderLength
+        - record.timeLength;
+    records.push_back(record);
+    layouts.emplace_back();
+
+    // spill in quarters of the budget so each segment is worth a write
+    if (residentBytes() > budget)
+    {
+        spill(residentBytes() - budget + budget / 4);
+    }
+}
+
+Scrollback::Item Scrollback::operator[](size_t item)
+{
+    if (item >= firstResident)
+    {
+        return view(records[item - firstResident], text.data(),
+            layouts[item - firstResident]);
+    }
+
+    // the last segment starting at or before the item holds it
+    size_t segment = std::upper_bound(segments.begin(), segments.end(), item,
+        [](size_t item, const Segment& segment)
+        {
+            return item < segment.firstItem;
+        }) - segments.begin() - 1;
+
+    Paged& page = pageIn(segment);
+
+    return view(page.records[item - segments[segment].firstItem],
+        page.text, page.layouts[item - segments[segment].firstItem]);
+}
+
+Scrollback::Item Scrollback::view(const Record& record, const char* text,
+    Layout& layout)
+{
+    const char* bytes = text + record.textOffset;
+
+    return Item{record, std::string_view(bytes, record.senderLength),
+        std::string_view(bytes + record.senderLength, record.timeLength),
+        std::string_view(bytes + record.senderLength + record.timeLength,
+            record.textLength), layout};
+}
+
+size_t Scrollback::size() const
+{
+    return firstResident + records.size();
+}
+
+size_t Scrollback::residentBegin() const
+{
+    return firstResident;
+}
+
+std::span<const uint32_t> Scrollback::breaks(const Layout& layout) const
+{
+    return std::span<const uint32_t>(breakArena).subspan(layout.breaksOffset,
+        layout.breakCount);
+}
+
+void Scrollback::setBreaks(Layout& layout, uint32_t generation,
+    std::span<const uint32_t> lineStarts)
+{
+    layout.generation = generation;
+    breakGeneration = generation;
+    layout.breaksOffset = breakArena.size();
+    layout.breakCount = lineStarts.size();
+    breakArena.insert(breakArena.end(), lineStarts.begin(), lineStarts.end());
+}
+
+void Scrollback::clearBreaks()
+{
+    // no layout in memory may keep pointing into the emptied arena
+    auto forget = [](Layout& layout) { layout = Layout(); };
+
+    std::for_each(layouts.begin(), layouts.end(), forget);
+
+    for (Paged& page : paged)
+    {
+        std::for_each(page.layouts.begin(), page.layouts.end(), forget);
+    }
+
+    breakArena.clear();
+    breakGeneration = 0;
+}
+
+void Scrollback::trim()
+{
+    paged.clear();
+
+    if (records.size() > MIN_RESIDENT_ITEMS)
+    {
+        spill(residentBytes());
+    }
+
+    compactBreaks(true);
+    records.shrink_to_fit();
+    layouts.shrink_to_fit();
+    text.shrink_to_fit();
+    breakArena.shrink_to_fit();
+}
+
+size_t Scrollback::memoryUsed() const
+{
+    return records.capacity() * sizeof(Record)
+        + layouts.capacity() * sizeof(Layout)
+        + text.capacity()
+        + breakArena.capacity() * sizeof(uint32_t);
+}
+
+size_t Scrollback::residentBytes() const
+{
+    return records.size() * (sizeof(Record) + sizeof(Layout)) + text.size()
+        + breakArena.size() * sizeof(uint32_t);
+}
+
+void Scrollback::spill(size_t bytes)
+{
+    if (!file)
+    {
+        file.reset(std::tmpfile());
+
+        // with nowhere to spill to the log just stays in memory
+        if (!file)
+        {
+            return;
+        }
+    }
+
+    size_t count = 0;
+    size_t freed = 0;
+
+    while (freed < bytes && records.size() - count > MIN_RESIDENT_ITEMS)
+    {
+        freed += sizeof(Record) + sizeof(Layout)
+            + records[count].senderLength + records[count].timeLength
+            + records[count].textLength
+            + layouts[count].breakCount * sizeof(uint32_t);
+        ++count;
+    }
+
+    // resident text starts with the first record's, so the spilled records'
+    // offsets hold within the segment as they are
+    size_t textLength = count < records.size() ? records[count].textOffset
+        : text.size();
+    size_t padding = -(count * sizeof(Record) + textLength) % SEGMENT_ALIGN;
+    const char zeros[SEGMENT_ALIGN] = {};
+
+    if (!count || std::fseek(file.get(), fileEnd, SEEK_SET)
+        || std::fwrite(records.data(), sizeof(Record), count, file.get())
+            != count
+        || std::fwrite(text.data(), 1, textLength, file.get()) != textLength
+        || std::fwrite(zeros, 1, padding, file.get()) != padding
+        || std::fflush(file.get()))
+    {
+        return;
+    }
+
+    segments.push_back(Segment{firstResident, count, fileEnd, textLength});
+    fileEnd += count * sizeof(Record) + textLength + padding;
+
+    records.erase(records.begin(), records.begin() + count);
+    layouts.erase(layouts.begin(), layouts.begin() + count);
+    text.erase(0, textLength);
+    firstResident += count;
+
+    for (Record& record : records)
+    {
+        record.textOffset -= textLength;
+    }
+
+    // the spilled items' breaks are what was counted as freed
+    compactBreaks(true);
+}
+
+Scrollback::Paged& Scrollback::pageIn(size_t segment)
+{
+    for (auto entry = paged.begin(); entry != paged.end(); ++entry)
+    {
+        if (entry->segment == segment)
+        {
+            paged.splice(paged.begin(), paged, entry);
+            return *entry;
+        }
+    }
+
+    paged.emplace_front(file.get(), segment, segments[segment]);
+
+    if (paged.size() > MAX_PAGED_SEGMENTS)
+    {
+        paged.pop_back();
+        compactBreaks();
+    }
+
+    return paged.front();
+}
+
+void Scrollback::compactBreaks(bool force)
+{
+    // layouts of an older generation are rewrapped before their breaks are
+    // read again, so only the current generation's are live
+    auto live = [&](const Layout& layout)
+    {
+        return layout.generation == breakGeneration && layout.breakCount;
+    };
+
+    size_t liveBreaks = 0;
+
+    for (const Layout& layout : layouts)
+    {
+        liveBreaks += live(layout) ? layout.breakCount : 0;
+    }
+
+    for (const Paged& page : paged)
+    {
+        for (const Layout& layout : page.layouts)
+        {
+            liveBreaks += live(layout) ? layout.breakCount : 0;
+        }
+    }
+
+    if (breakArena.size() == liveBreaks || (!force
+        && breakArena.size() <= 2 * liveBreaks + BREAK_SLACK))
+    {
+        return;
+    }
+
+    std::vector<uint32_t> compacted;
+    compacted.reserve(liveBreaks);
+
+    auto keep = [&](Layout& layout)
+    {
+        if (!live(layout))
+        {
+            return;
+        }
+
+        // breaks the arena no longer holds are rewrapped rather than read
+        if (layout.breaksOffset + layout.breakCount > breakArena.size())
+        {
+            layout = Layout();
+            return;
+        }
+
+        uint32_t offset = compacted.size();
+        compacted.insert(compacted.end(),
+            breakArena.begin() + layout.breaksOffset,
+            breakArena.begin() + layout.breaksOffset + layout.breakCount);
+        layout.breaksOffset = offset;
+    };
+
+    std::for_each(layouts.begin(), layouts.end(), keep);
+
+    for (Paged& page : paged)
+    {
+        std::for_each(page.layouts.begin(), page.layouts.end(), keep);
+    }
+
+    breakArena.swap(compacted);
+}
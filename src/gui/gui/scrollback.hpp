@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "log_item.hpp"
+#include "../../irc/atom_table.hpp"
+
+namespace gui
+{
+    // a display's log as fixed size records over one text arena, numbered
+    // from the first item ever logged. the newest stay in memory up to a
+    // byte budget; older ones are spilled to segments in an anonymous
+    // temporary file and read in place from a mapping of it when asked for
+    class Scrollback
+    {
+    public:
+        struct Record
+        {
+            int64_t timeLogged;
+            // a message's sender when it has no atom and its time label,
+            // formatted once when logged, then its text or a part's reason
+            // in the text arena
+            uint32_t textOffset;
+            uint32_t textLength;
+            // the sender, or the user joining or parting, as an atom of the
+            // display's network; irc::NO_ATOM for a sender kept as text
+            irc::Atom nick;
+            // log_item::LogItemType
+            uint8_t kind;
+            bool hasText;
+            uint8_t senderLength;
+            uint8_t timeLength;
+        };
+
+        // the record's wrapping under one layout generation, in memory only
+        struct Layout
+        {
+            uint32_t generation = 0;
+            uint32_t breaksOffset = 0;
+            uint32_t breakCount = 0;
+        };
+
+        struct Item
+        {
+            const Record& record;
+            // only for messages whose nick is irc::NO_ATOM
+            std::string_view sender;
+            // "[h:m:s]" for messages, empty otherwise
+            std::string_view timeLabel;
+            std::string_view text;
+            Layout& layout;
+        };
+
+        explicit Scrollback(size_t budget);
+
+        void push(const log_item::LogItem& logItem);
+        // maps the item's segment in if it was spilled; the item stays
+        // valid until a later call maps another segment in, pushes or trims
+        Item operator[](size_t item);
+        size_t size() const;
+        // items from here to size() are in memory
+        size_t residentBegin() const;
+
+        // offsets into the text of every wrapped line after the first
+        std::span<const uint32_t> breaks(const Layout& layout) const;
+        void setBreaks(Layout& layout, uint32_t generation,
+            std::span<const uint32_t> lineStarts);
+        // forgets every layout's breaks, once none are of use any more
+        void clearBreaks();
+
+        // spills all but the newest items and unmaps paged in segments
+        void trim();
+        // heap held by the records, text, layouts and breaks; nicks live in
+        // the network's atom table
+        size_t memoryUsed() const;
+
+    private:
+        struct Segment
+        {
+            size_t firstItem;
+            size_t count;
+            long offset;
+            size_t textLength;
+        };
+
+        // a spilled segment's records and text, mapped or read back in
+        class Paged
+        {
+            void* mapped = nullptr;
+            size_t mapLength = 0;
+            std::string bytes;
+
+        public:
+            Paged(FILE* file, size_t segment, const Segment& spilled);
+            ~Paged();
+            Paged(const Paged&) = delete;
+            Paged& operator=(const Paged&) = delete;
+
+            size_t segment;
+            const Record* records;
+            const char* text;
+            std::vector<Layout> layouts;
+        };
+
+        size_t budget;
+        std::vector<Record> records;
+        std::vector<Layout> layouts;
+        std::string text;
+        size_t firstResident = 0;
+        // local hour and minute of the last time label, for the next
+        std::time_t labelMinute = -1;
+        int labelHour = 0;
+        int labelMin = 0;
+        // breaks of resident and paged in items; spilled and evicted items
+        // leave theirs behind until the arena is compacted
+        std::vector<uint32_t> breakArena;
+        uint32_t breakGeneration = 0;
+
+        // created with the first spill, removed by the system once closed
+        std::unique_ptr<FILE, int (*)(FILE*)> file{nullptr, std::fclose};
+        long fileEnd = 0;
+        std::vector<Segment> segments;
+        // most recently used at the front
+        std::list<Paged> paged;
+
+        // the item over its record and the arena it points into
+        static Item view(const Record& record, const char* text,
+            Layout& layout);
+        size_t residentBytes() const;
+        void spill(size_t bytes);
+        Paged& pageIn(size_t segment);
+        // drops breaks no item in memory refers to, once they outweigh the
+        // rest
+        void compactBreaks(bool force = false);
+    };
+}
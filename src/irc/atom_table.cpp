@@ -0,0 +1,142 @@
+#include "atom_table.hpp"
+
+using namespace irc;
+
+char irc::foldCase(char c, CaseMapping caseMapping)
+{
+    if (c >= 'A' && c <= 'Z')
+    {
+        return c + ('a' - 'A');
+    }
+
+    // []\ are the uppercase of {}|, and ^ of ~ for plain rfc1459
+    if (caseMapping != CaseMapping::ASCII && ((c >= '[' && c <= ']')
+        || (c == '^' && caseMapping == CaseMapping::RFC1459)))
+    {
+        return c + ('{' - '[');
+    }
+
+    return c;
+}
+
+size_t AtomTable::FoldHash::operator()(std::string_view name) const
+{
+    // fnv-1a over the folded name
+    const CaseMapping mapping = caseMapping->load(std::memory_order_relaxed);
+    size_t hash = 14695981039346656037ull;
+
+    for (char c : name)
+    {
+        hash = (hash ^ static_cast<unsigned char>(foldCase(c, mapping)))
+            * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+bool AtomTable::FoldEqual::operator()(std::string_view a, std::string_view b)
+    const
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    const CaseMapping mapping = caseMapping->load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (foldCase(a[i], mapping) != foldCase(b[i], mapping))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+namespace
+{
+    std::atomic<uint32_t> nextTableId{1};
+}
+
+AtomTable::AtomTable()
+    : blocks(std::make_unique<std::atomic<std::string*>[]>(MAX_BLOCKS))
+    , tableId(nextTableId.fetch_add(1, std::memory_order_relaxed))
+    , index(0, FoldHash{&caseMapping}, FoldEqual{&caseMapping}) { }
+
+AtomTable::~AtomTable()
+{
+    for (size_t block = 0; block < MAX_BLOCKS; ++block)
+    {
+        delete[] blocks[block].load(std::memory_order_relaxed);
+    }
+}
+
+Atom AtomTable::intern(std::string_view name)
+{
+    auto found = index.find(name);
+
+    if (found != index.end())
+    {
+        return found->second;
+    }
+
+    if (count == BLOCK_SIZE * MAX_BLOCKS)
+    {
+        return NO_ATOM;
+    }
+
+    std::string* block = blocks[count / BLOCK_SIZE].load(
+        std::memory_order_relaxed);
+
+    if (!block)
+    {
+        block = new std::string[BLOCK_SIZE];
+        blocks[count / BLOCK_SIZE].store(block, std::memory_order_release);
+    }
+
+    // the queue that carries the atom to another thread publishes the name
+    std::string& stored = block[count % BLOCK_SIZE];
+    stored = name;
+    index.emplace(stored, count);
+
+    return count++;
+}
+
+std::string_view AtomTable::name(Atom atom) const
+{
+    return blocks[atom / BLOCK_SIZE].load(std::memory_order_acquire)
+        [atom % BLOCK_SIZE];
+}
+
+void AtomTable::setCaseMapping(CaseMapping caseMapping)
+{
+    if (caseMapping == this->caseMapping)
+    {
+        return;
+    }
+
+    this->caseMapping = caseMapping;
+    index.clear();
+
+    for (Atom atom = 0; atom < count; ++atom)
+    {
+        index.emplace(name(atom), atom);
+    }
+}
+
+CaseMapping AtomTable::getCaseMapping() const
+{
+    return caseMapping.load(std::memory_order_relaxed);
+}
+
+bool AtomTable::equal(std::string_view a, std::string_view b) const
+{
+    return FoldEqual{&caseMapping}(a, b);
+}
+
+uint32_t AtomTable::id() const
+{
+    return tableId;
+}
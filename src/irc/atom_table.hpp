@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace irc
+{
+    typedef uint32_t Atom;
+
+    // what intern() returns once a table has no room left
+    constexpr Atom NO_ATOM = UINT32_MAX;
+
+    // how a network compares nicks and channel names, from the CASEMAPPING
+    // token of RPL_ISUPPORT. rfc1459 also folds []\^ onto {}|~, the strict
+    // variant leaves ^ alone
+    enum class CaseMapping
+    {
+        ASCII,
+        RFC1459,
+        STRICT_RFC1459
+    };
+
+    char foldCase(char c, CaseMapping caseMapping);
+
+    // the nicks and channel names of one network as small ids, one per
+    // name under the network's casemapping. interning is for the reactor
+    // alone; names are read back from any thread without locking
+    class AtomTable
+    {
+        static constexpr size_t BLOCK_SIZE = 4096;
+        static constexpr size_t MAX_BLOCKS = 4096;
+
+        // the spelling each name was first seen with. blocks never move
+        // once published, so readers need no lock
+        std::unique_ptr<std::atomic<std::string*>[]> blocks;
+        size_t count = 0;
+        const uint32_t tableId;
+
+        struct FoldHash
+        {
+            const std::atomic<CaseMapping>* caseMapping;
+            size_t operator()(std::string_view name) const;
+        };
+
+        struct FoldEqual
+        {
+            const std::atomic<CaseMapping>* caseMapping;
+            bool operator()(std::string_view a, std::string_view b) const;
+        };
+
+        // written on the reactor, read wherever names are compared
+        std::atomic<CaseMapping> caseMapping{CaseMapping::RFC1459};
+        // keys view the names in blocks
+        std::unordered_map<std::string_view, Atom, FoldHash, FoldEqual> index;
+
+    public:
+        AtomTable();
+        ~AtomTable();
+        AtomTable(const AtomTable&) = delete;
+        AtomTable& operator=(const AtomTable&) = delete;
+
+        // reactor only. NO_ATOM once 16M names are held, as atoms are
+        // never reclaimed
+        Atom intern(std::string_view name);
+        // any thread, for atoms handed out through the response queue
+        std::string_view name(Atom atom) const;
+
+        // reactor only. names that now fold together keep their own atoms,
+        // later lookups find the first of them
+        void setCaseMapping(CaseMapping caseMapping);
+        // any thread
+        CaseMapping getCaseMapping() const;
+        bool equal(std::string_view a, std::string_view b) const;
+
+        // unique across every table, to tell apart atoms of two networks
+        uint32_t id() const;
+    };
+}
@@ -0,0 +1,97 @@
+#include "capture.hpp"
+
+using namespace irc;
+
+#define CAPTURE_MAGIC "IRCCAP01"
+#define CAPTURE_MAGIC_SIZE 8
+
+CaptureError::CaptureError(std::string message) : message(message) { }
+
+const char* CaptureError::what() const noexcept
+{
+    return message.c_str();
+}
+
+CaptureWriter::CaptureWriter(const std::string& path)
+    : file(path, std::ios::binary | std::ios::trunc)
+    , start(std::chrono::steady_clock::now())
+{
+    if (!file)
+    {
+        throw CaptureError("failed to open capture file " + path);
+    }
+
+    int64_t started = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    file.write(CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+    file.write(reinterpret_cast<const char*>(&started), sizeof(started));
+}
+
+void CaptureWriter::record(const char* data, size_t size)
+{
+    int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    uint32_t length = size;
+
+    file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(data, size);
+}
+
+CaptureReader::CaptureReader(const std::string& path)
+    : file(path, std::ios::binary)
+{
+    char magic[CAPTURE_MAGIC_SIZE];
+    int64_t start;
+
+    if (!file.read(magic, CAPTURE_MAGIC_SIZE)
+        || std::string_view(magic, CAPTURE_MAGIC_SIZE) != CAPTURE_MAGIC
+        || !file.read(reinterpret_cast<char*>(&start), sizeof(start)))
+    {
+        throw CaptureError("not a capture file: " + path);
+    }
+
+    file.seekg(0, std::ios::end);
+    fileSize = file.tellg();
+    file.seekg(CAPTURE_MAGIC_SIZE + sizeof(start));
+
+    started = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::nanoseconds(start)));
+}
+
+std::chrono::system_clock::time_point CaptureReader::startTime() const
+{
+    return started;
+}
+
+std::optional<CaptureReader::Chunk> CaptureReader::next(size_t maxSize)
+{
+    int64_t offset;
+    uint32_t size;
+
+    // a record cut short by the client being killed ends the capture
+    if (!file.read(reinterpret_cast<char*>(&offset), sizeof(offset))
+        || !file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+    {
+        return std::nullopt;
+    }
+
+    // a corrupt size would otherwise have the replay allocate up to 4 GiB
+    const std::streamoff position = file.tellg();
+
+    if (size > maxSize || size > fileSize - position)
+    {
+        throw CaptureError("bad capture record of " + std::to_string(size)
+            + " bytes at offset " + std::to_string(position));
+    }
+
+    return Chunk{std::chrono::nanoseconds(offset), size};
+}
+
+size_t CaptureReader::read(std::span<char> out)
+{
+    file.read(out.data(), out.size());
+    return file.gcount();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace irc
+{
+    class CaptureError : public std::exception
+    {
+        std::string message;
+    public:
+        CaptureError(std::string message);
+        const char* what() const noexcept override;
+    };
+
+    // raw bytes as received from a server, one record per read, each
+    // stamped with its time since the capture started. fields are written
+    // in host byte order so captures move between similar machines only
+    class CaptureWriter
+    {
+        std::ofstream file;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit CaptureWriter(const std::string& path);
+        void record(const char* data, size_t size);
+    };
+
+    class CaptureReader
+    {
+        std::ifstream file;
+        std::chrono::system_clock::time_point started;
+        std::streamoff fileSize;
+
+    public:
+        struct Chunk
+        {
+            std::chrono::nanoseconds offset;
+            uint32_t size;
+        };
+
+        explicit CaptureReader(const std::string& path);
+
+        // wall clock time the capture was started at
+        std::chrono::system_clock::time_point startTime() const;
+
+        // header of the next record, or nothing at the end of the capture;
+        // its bytes must be read() before the following call. throws
+        // CaptureError for a record larger than maxSize or than what is
+        // left of the file
+        std::optional<Chunk> next(size_t maxSize);
+        size_t read(std::span<char> out);
+    };
+}
@@ -0,0 +1,98 @@
+#include "connection_manager.hpp"
+#include <algorithm>
+
+using namespace irc;
+
+ConnectionManager::ConnectionManager(size_t threadCount)
+    : work(asio::make_work_guard(io_context))
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([this] { io_context.run(); });
+    }
+}
+
+ConnectionManager::~ConnectionManager()
+{
+    stop();
+}
+
+void ConnectionManager::stop()
+{
+    // servers wait for their own handlers, so they go while threads remain
+    for (std::unique_ptr<Server>& server : servers)
+    {
+        server->disconnect();
+    }
+
+    servers.clear();
+    work.reset();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    threads.clear();
+}
+
+Server& ConnectionManager::add(std::string host, std::string port)
+{
+    servers.push_back(std::make_unique<Server>(io_context, std::move(host),
+        std::move(port)));
+
+    if (notify)
+    {
+        servers.back()->setNotify(notify);
+    }
+
+    return *servers.back();
+}
+
+void ConnectionManager::remove(Server& server)
+{
+    auto found = std::find_if(servers.begin(), servers.end(),
+        [&](const std::unique_ptr<Server>& s) { return s.get() == &server; });
+
+    if (found != servers.end())
+    {
+        (*found)->disconnect();
+        servers.erase(found);
+    }
+}
+
+const std::vector<std::unique_ptr<Server>>& ConnectionManager::getServers()
+    const
+{
+    return servers;
+}
+
+void ConnectionManager::setNotify(std::function<void()> notify)
+{
+    this->notify = notify;
+
+    for (std::unique_ptr<Server>& server : servers)
+    {
+        server->setNotify(notify);
+    }
+}
+
+size_t ConnectionManager::fetch(std::vector<Fetched>& responses)
+{
+    size_t count = 0;
+
+    for (std::unique_ptr<Server>& server : servers)
+    {
+        count += server->fetch([&](response::responseVarient&& response)
+        {
+            responses.push_back(Fetched { server.get(), std::move(response) });
+        });
+    }
+
+    return count;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <asio.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "network.hpp"
+
+namespace irc
+{
+    // owns the io_context threads and every Server multiplexed on them. the
+    // thread count follows the core count, not the number of networks
+    class ConnectionManager
+    {
+        asio::io_context io_context;
+        asio::executor_work_guard<asio::io_context::executor_type> work;
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<Server>> servers;
+        std::function<void()> notify;
+
+    public:
+        struct Fetched
+        {
+            Server* server;
+            response::responseVarient response;
+        };
+
+        // threadCount 0 uses one thread per core
+        explicit ConnectionManager(size_t threadCount = 0);
+        ~ConnectionManager();
+
+        // disconnects and drops every server, then joins the threads, so no
+        // handler or notify hook runs after it returns. the destructor
+        // calls it too
+        void stop();
+
+        Server& add(std::string host, std::string port);
+        void remove(Server& server);
+        const std::vector<std::unique_ptr<Server>>& getServers() const;
+
+        // handed to every server, present and future; see Server::setNotify.
+        // call before any server added here connects or replays
+        void setNotify(std::function<void()> notify);
+
+        // drains the queues of all servers into one list for the ui thread
+        size_t fetch(std::vector<Fetched>& responses);
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace irc
+{
+    template<typename E>
+    struct Unexpected
+    {
+        E error;
+    };
+
+    template<typename E> Unexpected(E) -> Unexpected<E>;
+
+    // minimal stand-in for c++23 std::expected: either a value or the reason
+    // there is none, reported without throwing
+    template<typename T, typename E>
+    class Expected
+    {
+        std::variant<T, E> storage;
+
+    public:
+        template<typename U>
+            requires std::constructible_from<T, U&&>
+        Expected(U&& value)
+            : storage(std::in_place_index<0>, std::forward<U>(value)) { }
+
+        Expected(Unexpected<E> error)
+            : storage(std::in_place_index<1>, std::move(error.error)) { }
+
+        bool has_value() const noexcept
+        {
+            return storage.index() == 0;
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return has_value();
+        }
+
+        // unchecked, like std::expected
+        T& operator*() noexcept
+        {
+            return *std::get_if<0>(&storage);
+        }
+
+        T* operator->() noexcept
+        {
+            return std::get_if<0>(&storage);
+        }
+
+        const E& error() const noexcept
+        {
+            return *std::get_if<1>(&storage);
+        }
+    };
+}
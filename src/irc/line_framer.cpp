@@ -0,0 +1,126 @@
+#include "line_framer.hpp"
+#include "scan.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace irc;
+
+// longest partial line held; well past the 512 bytes of a line and the
+// 8191 of its message tags
+#define MAX_PARTIAL_LINE 16384
+
+LineFramer::LineFramer(size_t initialSize) : buffer(initialSize) { }
+
+std::span<char> LineFramer::prepare(size_t minSize)
+{
+    if (begin == end)
+    {
+        // an overlong line being discarded carries on past this
+        lineEnds.clear();
+        nextLineEnd = 0;
+        begin = end = 0;
+    }
+
+    if (buffer.size() - end < minSize && begin > 0)
+    {
+        // move the partial line to the front instead of growing
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+
+        lineEnds.erase(lineEnds.begin(), lineEnds.begin() + nextLineEnd);
+        nextLineEnd = 0;
+        for (uint32_t& lineEnd : lineEnds)
+        {
+            lineEnd -= begin;
+        }
+
+        end -= begin;
+        begin = 0;
+    }
+
+    if (buffer.size() - end < minSize)
+    {
+        buffer.resize(std::max(buffer.size() * 2, end + minSize));
+    }
+
+    return std::span<char>(buffer.data() + end, buffer.size() - end);
+}
+
+void LineFramer::commit(size_t length)
+{
+    length = std::min(length, buffer.size() - end);
+    const size_t scanned = lineEnds.size();
+    scan::findAll(buffer.data() + end, length, '\n', lineEnds, end);
+
+    if (discarding && lineEnds.size() > scanned)
+    {
+        // the overlong line ends in this read; drop it up to its '\n'
+        const size_t cut = lineEnds[scanned] + 1 - end;
+        std::memmove(buffer.data() + end, buffer.data() + end + cut,
+            length - cut);
+        lineEnds.erase(lineEnds.begin() + scanned);
+
+        for (size_t i = scanned; i < lineEnds.size(); ++i)
+        {
+            lineEnds[i] -= cut;
+        }
+
+        length -= cut;
+        discarding = false;
+    }
+    else if (discarding)
+    {
+        length = 0;
+    }
+
+    end += length;
+
+    // a line with no end in sight is dropped rather than grown without
+    // limit; complete lines may still arrive in bursts of any size
+    const size_t partial = lineEnds.empty() ? begin : lineEnds.back() + 1;
+
+    if (end - partial > MAX_PARTIAL_LINE)
+    {
+        end = partial;
+        discarding = true;
+    }
+}
+
+std::optional<std::string_view> LineFramer::next()
+{
+    const char* data = buffer.data();
+
+    while (nextLineEnd < lineEnds.size())
+    {
+        size_t lineBegin = begin;
+        size_t lineEnd = lineEnds[nextLineEnd++];
+        begin = lineEnd + 1;
+
+        if (lineEnd > lineBegin && data[lineEnd - 1] == '\r')
+        {
+            --lineEnd;
+        }
+
+        if (lineEnd > lineBegin)
+        {
+            return std::string_view(data + lineBegin, lineEnd - lineBegin);
+        }
+    }
+
+    lineEnds.clear();
+    nextLineEnd = 0;
+
+    return std::nullopt;
+}
+
+size_t LineFramer::pending() const
+{
+    return end - begin;
+}
+
+void LineFramer::reset()
+{
+    lineEnds.clear();
+    nextLineEnd = 0;
+    begin = end = 0;
+    discarding = false;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace irc
+{
+    // per-connection buffer that splits a byte stream into lines. each read
+    // is scanned once for every '\n' it holds, partial lines carry over
+    // between reads and the returned lines are views into the buffer, valid
+    // until the next prepare(). a partial line past 16 KiB is dropped up to
+    // its '\n'
+    class LineFramer
+    {
+        std::vector<char> buffer;
+        std::vector<uint32_t> lineEnds; // offsets of every '\n' received
+        size_t nextLineEnd = 0;         // first entry not yet handed out
+        size_t begin = 0;               // start of the first unconsumed line
+        size_t end = 0;                 // end of received data
+        bool discarding = false;        // inside a line too long to keep
+
+    public:
+        explicit LineFramer(size_t initialSize = 4096);
+
+        // writable space of at least minSize bytes for the next read
+        std::span<char> prepare(size_t minSize);
+        void commit(size_t length);
+
+        // next complete line without its "\r\n", empty lines are skipped
+        std::optional<std::string_view> next();
+
+        size_t pending() const;
+        void reset();
+    };
+}
@@ -0,0 +1,160 @@
+#include "message.hpp"
+#include "scan.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace irc;
+
+Message::Message(std::string_view raw)
+    : line(raw.substr(0, std::numeric_limits<uint16_t>::max()))
+{
+    parse();
+}
+
+std::string_view Message::view(Slice slice) const
+{
+    return std::string_view(line).substr(slice.pos, slice.len);
+}
+
+void Message::parse()
+{
+    const std::string_view text(line);
+    size_t pos = 0;
+
+    auto slice = [](size_t from, size_t to) -> Slice
+    {
+        return Slice { static_cast<uint16_t>(from),
+            static_cast<uint16_t>(to - from) };
+    };
+
+    auto wordEnd = [&](size_t from) -> size_t
+    {
+        return from + scan::find(text.data() + from, text.size() - from, ' ');
+    };
+
+    auto skipSpaces = [&]
+    {
+        while (pos < text.size() && text[pos] == ' ')
+        {
+            ++pos;
+        }
+    };
+
+    if (pos < text.size() && text[pos] == '@')
+    {
+        size_t end = wordEnd(pos);
+        tagsSlice = slice(pos + 1, end);
+        pos = end;
+        skipSpaces();
+    }
+
+    if (pos < text.size() && text[pos] == ':')
+    {
+        size_t end = wordEnd(pos);
+        prefixSlice = slice(pos + 1, end);
+
+        // nick[!user][@host]
+        std::string_view prefix = text.substr(pos + 1, end - pos - 1);
+        size_t at = prefix.find('@');
+        size_t bang = prefix.substr(0, at).find('!');
+        size_t nickEnd = std::min(bang, at);
+        nickEnd = nickEnd == std::string_view::npos ? prefix.size() : nickEnd;
+        nickSlice = slice(pos + 1, pos + 1 + nickEnd);
+
+        if (bang != std::string_view::npos)
+        {
+            size_t userEnd = at == std::string_view::npos ? prefix.size() : at;
+            userSlice = slice(pos + 2 + bang, pos + 1 + userEnd);
+        }
+
+        if (at != std::string_view::npos)
+        {
+            hostSlice = slice(pos + 2 + at, end);
+        }
+
+        pos = end;
+        skipSpaces();
+    }
+
+    size_t commandEnd = wordEnd(pos);
+    commandSlice = slice(pos, commandEnd);
+    pos = commandEnd;
+
+    for (;;)
+    {
+        skipSpaces();
+
+        if (pos >= text.size())
+        {
+            break;
+        }
+
+        // the final slot swallows the rest of the line like a trailing one
+        if (text[pos] == ':' || nParams == MAX_PARAMS - 1)
+        {
+            trailingParam = text[pos] == ':';
+            pos += trailingParam;
+            paramSlices[nParams++] = slice(pos, text.size());
+            break;
+        }
+
+        size_t end = wordEnd(pos);
+        paramSlices[nParams++] = slice(pos, end);
+        pos = end;
+    }
+}
+
+std::string_view Message::raw() const
+{
+    return line;
+}
+
+std::string_view Message::tags() const
+{
+    return view(tagsSlice);
+}
+
+std::string_view Message::prefix() const
+{
+    return view(prefixSlice);
+}
+
+std::string_view Message::nick() const
+{
+    return view(nickSlice);
+}
+
+std::string_view Message::user() const
+{
+    return view(userSlice);
+}
+
+std::string_view Message::host() const
+{
+    return view(hostSlice);
+}
+
+std::string_view Message::command() const
+{
+    return view(commandSlice);
+}
+
+size_t Message::paramCount() const
+{
+    return nParams;
+}
+
+std::string_view Message::param(size_t index) const
+{
+    return index < nParams ? view(paramSlices[index]) : std::string_view();
+}
+
+bool Message::hasTrailing() const
+{
+    return trailingParam;
+}
+
+std::string_view Message::trailing() const
+{
+    return trailingParam ? view(paramSlices[nParams - 1]) : std::string_view();
+}
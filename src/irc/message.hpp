@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace irc
+{
+    // a single parsed irc line. the message owns the line and every
+    // component is a view into it, so parsing costs at most one allocation.
+    // positions are stored rather than pointers so moving a message (and its
+    // possibly small-string-optimised buffer) keeps the views valid
+    class Message
+    {
+    public:
+        static constexpr size_t MAX_PARAMS = 15;
+
+    private:
+        struct Slice
+        {
+            uint16_t pos = 0;
+            uint16_t len = 0;
+        };
+
+        std::string line;
+        Slice tagsSlice;
+        Slice prefixSlice;
+        Slice nickSlice;
+        Slice userSlice;
+        Slice hostSlice;
+        Slice commandSlice;
+        std::array<Slice, MAX_PARAMS> paramSlices;
+        uint8_t nParams = 0;
+        bool trailingParam = false;
+
+        std::string_view view(Slice slice) const;
+        void parse();
+
+    public:
+        Message() = default;
+        explicit Message(std::string_view raw);
+
+        std::string_view raw() const;
+        std::string_view tags() const;
+
+        // prefix without the leading ':', split into nick!user@host. a
+        // server prefix has no '!' or '@' and is reported as the nick
+        std::string_view prefix() const;
+        std::string_view nick() const;
+        std::string_view user() const;
+        std::string_view host() const;
+
+        std::string_view command() const;
+
+        // middle parameters followed by the trailing one, if any; an index
+        // past the end gives an empty view
+        size_t paramCount() const;
+        std::string_view param(size_t index) const;
+
+        // the last parameter when it was introduced with ':'
+        bool hasTrailing() const;
+        std::string_view trailing() const;
+    };
+}
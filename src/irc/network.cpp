@@ -1,153 +1,1068 @@
 #include "network.hpp"
 #include <asio.hpp>
 #include <string>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <sstream>
 #include <utility>
 
-#define READ_BUF_SIZE 512
+#define READ_BUF_SIZE 4096
+// largest single read, and so the largest capture record replayed
+#define MAX_READ_SIZE (1 << 20)
+// longest line excluding "\r\n"
+#define MAX_LINE_LENGTH 510
 
 using namespace irc;
 
-Server::Server(std::string host, std::string port)
+Server::Server(asio::io_context& io_context, std::string host,
+    std::string port)
     : host(host)
     , port(port)
-    , resolver(io_context)
-    , endpoints(resolver.resolve(host, port))
-    , socket(io_context) { }
+    , strand(asio::make_strand(io_context))
+    , resolver(strand)
+    , socket(strand)
+    , attemptTimer(strand)
+    , reconnectTimer(strand)
+    , backlogTimer(strand)
+    , floodTimer(strand)
+    , closeTimer(strand) { }
 
 Server::~Server()
 {
-    connected = false;
+    disconnect();
+}
+
+void Server::readResponses()
+{
+    if (!socket.is_open())
+    {
+        // closed while waiting on the backlog
+        return;
+    }
 
-    for (User* u : users)
+    if (!flushBacklog())
     {
-        delete u;
+        // stop reading until the ui drains the queue so tcp pushes back on
+        // the sender instead of us buffering without bound
+        backlogTimer.expires_after(std::chrono::milliseconds(1));
+        backlogTimer.async_wait([this, id = connection, op = beginOp()](
+            const asio::error_code& error)
+        {
+            if (!error && id == connection)
+            {
+                readResponses();
+            }
+        });
+
+        return;
     }
+
+    // size the read to whatever the kernel already holds so a burst is
+    // framed in one pass
+    asio::error_code ignored;
+    std::span<char> space = framer.prepare(std::clamp<size_t>(
+        socket.available(ignored), READ_BUF_SIZE, MAX_READ_SIZE));
+    space = space.first(std::min<size_t>(space.size(), MAX_READ_SIZE));
+
+    socket.async_read_some(asio::buffer(space.data(), space.size()),
+        [this, id = connection, data = space.data(), op = beginOp()](
+            const asio::error_code& error, size_t readLen)
+        {
+            if (id != connection)
+            {
+                return;
+            }
+
+            if (error)
+            {
+                // eof, reset by peer or cancelled by disconnect()
+                connectionLost(error.message());
+                return;
+            }
+
+            if (captureFile)
+            {
+                captureFile->record(data, readLen);
+            }
+
+            queueResponses(readLen);
+            readResponses();
+        });
 }
 
-static std::string readOverflow = "";
-void Server::queueResponses()
+void Server::queueResponses(size_t readLen)
 {
-    while (connected)
+    framer.commit(readLen);
+
+    while (std::optional<std::string_view> line = framer.next())
     {
-        std::array<char, READ_BUF_SIZE> buf;
+#ifdef IRCTF_TRACE
+        std::cout << ">>> " << *line << '\n';
+#endif
 
-        size_t readLen;
+        response::ParseResult result = response::readResponse(*line);
 
-        try
+        if (!result)
         {
-            readLen = {socket.read_some(asio::buffer(buf))};
+            std::cerr << "[!] " << result.error().what() << " : { " << *line
+                << " }\n";
+            continue;
         }
-        catch (asio::system_error& e)
+
+        if (!trackState(*result))
+        {
+            std::cerr << "[!] atom table full : { " << *line << " }\n";
+            continue;
+        }
+
+        queueResponse(std::move(*result));
+    }
+
+    notifyQueued();
+}
+
+void Server::queueResponse(response::responseVarient&& response)
+{
+    if (!responseBacklog.empty() || !responseQueue.tryPush(std::move(response)))
+    {
+        responseBacklog.push_back(std::move(response));
+        return;
+    }
+
+    size_t depth = responseQueue.size();
+    if (depth > maxDepth.load(std::memory_order_relaxed))
+    {
+        maxDepth.store(depth, std::memory_order_relaxed);
+    }
+}
+
+bool Server::flushBacklog()
+{
+    bool moved = false;
+
+    while (!responseBacklog.empty()
+        && responseQueue.tryPush(std::move(responseBacklog.front())))
+    {
+        responseBacklog.pop_front();
+        moved = true;
+    }
+
+    if (moved)
+    {
+        notifyQueued();
+    }
+
+    if (responseQueue.size() > maxDepth.load(std::memory_order_relaxed))
+    {
+        maxDepth.store(responseQueue.size(), std::memory_order_relaxed);
+    }
+
+    return responseBacklog.empty();
+}
+
+void Server::capture(const std::string& path)
+{
+    asio::post(strand, [this, file = std::make_unique<CaptureWriter>(path),
+        op = beginOp()]() mutable
+    {
+        captureFile = std::move(file);
+    });
+}
+
+void Server::replay(const std::string& path, bool paced)
+{
+    asio::post(strand, [this, path, paced,
+        file = std::make_unique<CaptureReader>(path), op = beginOp()]() mutable
+    {
+        replayFile = std::move(file);
+        replayChunk.reset();
+        replayPaced = paced;
+        replaying = true;
+        outbound.clear();
+        replayStart = std::chrono::steady_clock::now();
+        reportStatus(response::Status::CONNECTED, "replaying " + path);
+        replayNext();
+    });
+}
+
+void Server::replayNext()
+{
+    if (!replayFile || closing)
+    {
+        return;
+    }
+
+    // same back-pressure as a live connection, and for paced replay the
+    // same timer waits out the gap to the next record
+    std::optional<std::chrono::steady_clock::time_point> wait;
+
+    if (!flushBacklog())
+    {
+        wait = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+    }
+    else
+    {
+        if (!replayChunk)
         {
-            if (e.code() == asio::error::eof)
+            try
             {
+                replayChunk = replayFile->next(MAX_READ_SIZE);
+            }
+            catch (const CaptureError& error)
+            {
+                endReplay(response::Status::FAILED, error.what());
+                return;
+            }
+
+            if (!replayChunk)
+            {
+                endReplay(response::Status::DISCONNECTED, "end of capture");
                 return;
             }
         }
 
-        std::string bufStr = std::string(buf.data(), readLen);
+        if (replayPaced && std::chrono::steady_clock::now()
+            < replayStart + replayChunk->offset)
+        {
+            wait = replayStart + replayChunk->offset;
+        }
+    }
 
-        if (bufStr.back() != '\n')
+    if (wait)
+    {
+        backlogTimer.expires_at(*wait);
+        backlogTimer.async_wait([this, op = beginOp()](
+            const asio::error_code& error)
         {
-            readOverflow += bufStr;
-            continue;
+            if (!error)
+            {
+                replayNext();
+            }
+        });
+
+        return;
+    }
+
+    std::span<char> space = framer.prepare(replayChunk->size);
+    queueResponses(replayFile->read(space.first(replayChunk->size)));
+    replayChunk.reset();
+
+    // a record per turn so sends and disconnect() still get the strand
+    asio::post(strand, [this, op = beginOp()] { replayNext(); });
+}
+
+void Server::endReplay(response::Status::State state, std::string detail)
+{
+    // replaying stays set, the responses already queued may still be
+    // answered by the ui
+    replayFile.reset();
+    replayChunk.reset();
+    reportStatus(state, std::move(detail));
+}
+
+void Server::notifyQueued()
+{
+    // the exchange pairs with the one in fetch(), so a response pushed
+    // after the ui drained the queue always brings another wakeup
+    if (notify && responseQueue.size() && !notified.exchange(true))
+    {
+        notify();
+    }
+}
+
+void Server::connect()
+{
+    // returns straight away; progress arrives as response::Status. lines
+    // sent meanwhile are held until the connection is up
+    replaying = false;
+
+    asio::post(strand, [this, op = beginOp()]
+    {
+        closing = false;
+        quitting = false;
+        startConnect();
+    });
+}
+
+void Server::startConnect()
+{
+    if (connected || connecting || closing)
+    {
+        return;
+    }
+
+    connecting = true;
+    reportStatus(response::Status::RESOLVING, host + ":" + port);
+
+    resolver.async_resolve(host, port, [this, op = beginOp()](
+        const asio::error_code& error,
+        const tcp::resolver::results_type& results)
+    {
+        if (error)
+        {
+            connectFailed(error.message());
+            return;
         }
-        else
+
+        resolved(results);
+    });
+}
+
+void Server::connectFailed(const std::string& reason)
+{
+    connecting = false;
+
+    if (closing)
+    {
+        return;
+    }
+
+    reportStatus(response::Status::FAILED, reason);
+    scheduleReconnect();
+}
+
+void Server::resolved(const tcp::resolver::results_type& results)
+{
+    if (closing)
+    {
+        return;
+    }
+
+    // alternate address families, starting with whichever came first
+    std::vector<tcp::endpoint> first;
+    std::vector<tcp::endpoint> second;
+
+    for (const tcp::endpoint endpoint : results)
+    {
+        bool sameFamily = first.empty()
+            || first.front().protocol() == endpoint.protocol();
+        (sameFamily ? first : second).push_back(endpoint);
+    }
+
+    candidates.clear();
+    for (size_t i = 0; i < std::max(first.size(), second.size()); ++i)
+    {
+        if (i < first.size())
         {
-            bufStr = readOverflow + bufStr;
-            readOverflow.clear();
+            candidates.push_back(first[i]);
         }
 
-        queueMutex.lock();
+        if (i < second.size())
+        {
+            candidates.push_back(second[i]);
+        }
+    }
+
+    nextCandidate = 0;
+    failedAttempts = 0;
+    startAttempt();
+}
+
+void Server::startAttempt()
+{
+    if (closing || nextCandidate >= candidates.size())
+    {
+        return;
+    }
+
+    const tcp::endpoint& endpoint = candidates[nextCandidate++];
+    std::stringstream address;
+    address << endpoint;
+    reportStatus(response::Status::CONNECTING, address.str());
+
+    tcp::socket* attempt = attempts.emplace_back(
+        std::make_unique<tcp::socket>(strand)).get();
 
-        size_t pos;
-        for (int iter = 0; (pos = bufStr.find("\r\n")) != std::string::npos;
-            iter++)
+    attempt->async_connect(endpoint, [this, attempt, op = beginOp()](
+        const asio::error_code& error)
+    {
+        attemptFinished(attempt, error);
+    });
+
+    // give this attempt a head start before racing the next endpoint
+    attemptTimer.expires_after(std::chrono::milliseconds(250));
+    attemptTimer.async_wait([this, op = beginOp()](
+        const asio::error_code& error)
+    {
+        if (!error && !connected)
         {
-            std::string word = bufStr.substr(0, pos);
-            std::cout << ">>> " << word << '\n';
+            startAttempt();
+        }
+    });
+}
 
-            responseQueue.emplace_back(response::readResponse(std::move(word)));
+void Server::attemptFinished(tcp::socket* attempt,
+    const asio::error_code& error)
+{
+    // a loser cancelled after another attempt won, or a late failure
+    if (connected || closing || attempts.empty())
+    {
+        return;
+    }
 
-            bufStr = bufStr.substr(pos += 2);
+    if (error)
+    {
+        if (++failedAttempts == candidates.size())
+        {
+            attemptTimer.cancel();
+            attempts.clear();
+            connectFailed(error.message());
+        }
+        else if (nextCandidate == failedAttempts)
+        {
+            // nothing else in flight, don't wait out the stagger
+            startAttempt();
         }
 
-        queueMutex.unlock();
+        return;
+    }
+
+    socket = std::move(*attempt);
+    attemptTimer.cancel();
+    attempts.clear();
+    candidates.clear();
+    connecting = false;
+    connected = true;
+
+    std::stringstream address;
+    address << socket.remote_endpoint();
+    reportStatus(response::Status::CONNECTED, address.str());
+
+    sendRegistration();
+    readResponses();
+    flushOutbound();
+}
+
+void Server::connectionLost(const std::string& reason)
+{
+    if (!connected)
+    {
+        return;
     }
 
+    connected = false;
+    registered = false;
+    ++connection;
+
+    // anything still queued was meant for the old session
+    shutdownSocket();
+    framer.reset();
+    outbound.clear();
+
+#ifdef IRCTF_TRACE
     std::cout << "!connected\n";
+#endif
+    reportStatus(response::Status::DISCONNECTED, reason);
+
+    if (closing || quitting)
+    {
+        closeSocket();
+        return;
+    }
+
+    scheduleReconnect();
 }
 
-void Server::connect()
+void Server::scheduleReconnect()
+{
+    // exponential backoff from one second up to five minutes, randomised
+    // over the upper half so clients dropped by a netsplit don't all come
+    // back at the same moment
+    double ceiling = std::min(300.0, std::ldexp(1.0,
+        std::min(reconnectAttempt++, 9u)));
+    double delay = std::uniform_real_distribution<double>(ceiling / 2,
+        ceiling)(jitter);
+
+    std::stringstream detail;
+    detail.precision(1);
+    detail << std::fixed << delay << 's';
+    reportStatus(response::Status::RECONNECTING, detail.str());
+
+    reconnectTimer.expires_after(std::chrono::duration_cast<
+        std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(delay)));
+    reconnectTimer.async_wait([this, op = beginOp()](
+        const asio::error_code& error)
+    {
+        if (!error)
+        {
+            startConnect();
+        }
+    });
+}
+
+void Server::sendRegistration()
+{
+    if (!registration.nick.empty())
+    {
+        send({"NICK ", registration.nick}, OutboundQueue::Priority::URGENT);
+    }
+
+    if (!registration.username.empty())
+    {
+        send({"USER ", registration.username, " 0 * :", registration.realname},
+            OutboundQueue::Priority::URGENT);
+    }
+}
+
+void Server::rejoinChannels()
 {
-    if (connected)
+    // as few JOIN lines as fit in the line limit rather than one per channel
+    std::string line;
+
+    for (Atom atom : channels)
+    {
+        std::string_view channel = atoms.name(atom);
+
+        if (!line.empty() && line.size() + 1 + channel.size() > MAX_LINE_LENGTH)
+        {
+            send({line}, OutboundQueue::Priority::BULK);
+            line.clear();
+        }
+
+        line.append(line.empty() ? "JOIN " : ",").append(channel);
+    }
+
+    if (!line.empty())
+    {
+        send({line}, OutboundQueue::Priority::BULK);
+    }
+}
+
+void Server::rememberChannel(std::string_view channel)
+{
+    Atom atom = atoms.intern(channel);
+
+    if (std::find(channels.begin(), channels.end(), atom) == channels.end())
+    {
+        channels.push_back(atom);
+    }
+}
+
+void Server::forgetChannel(std::string_view channel)
+{
+    auto found = std::find(channels.begin(), channels.end(),
+        atoms.intern(channel));
+
+    if (found != channels.end())
+    {
+        channels.erase(found);
+    }
+}
+
+bool Server::trackState(response::responseVarient& response)
+{
+    using namespace response;
+
+    if (Numeric* numeric = std::get_if<Numeric>(&response))
+    {
+        if (numeric->numericID == Numeric::RPL_WELCOME)
+        {
+            // the server may have truncated or changed the nick we asked for;
+            // registration goes ahead even when it cannot be interned
+            self.store(atoms.intern(numeric->parsed.param(0)),
+                std::memory_order_release);
+            registered = true;
+            reconnectAttempt = 0;
+            rejoinChannels();
+        }
+        else if (numeric->numericID == Numeric::RPL_ISUPPORT)
+        {
+            // <nick> <token>... :are supported by this server
+            for (size_t i = 1; i + 1 < numeric->parsed.paramCount(); ++i)
+            {
+                std::string_view token = numeric->parsed.param(i);
+
+                if (token == "CASEMAPPING=ascii"
+                    || token == "CASEMAPPING=rfc7613")
+                {
+                    // rfc7613 folds beyond ascii, which nicks rarely use
+                    atoms.setCaseMapping(CaseMapping::ASCII);
+                }
+                else if (token == "CASEMAPPING=rfc1459")
+                {
+                    atoms.setCaseMapping(CaseMapping::RFC1459);
+                }
+                else if (token == "CASEMAPPING=strict-rfc1459")
+                {
+                    atoms.setCaseMapping(CaseMapping::STRICT_RFC1459);
+                }
+                else if (token.starts_with("PREFIX=("))
+                {
+                    // PREFIX=(modes)symbols, the same set the ui ranks by
+                    namesPrefixes = token.substr(std::min(token.find(')') + 1,
+                        token.size()));
+                }
+            }
+        }
+    }
+    else if (Join* join = std::get_if<Join>(&response))
+    {
+        join->channelAtom = atoms.intern(join->channel());
+        join->nickAtom = atoms.intern(join->nick());
+
+        if (join->channelAtom == NO_ATOM || join->nickAtom == NO_ATOM)
+        {
+            return false;
+        }
+
+        if (isSelf(join->nickAtom))
+        {
+            rememberChannel(join->channel());
+        }
+    }
+    else if (Privmsg* privmsg = std::get_if<Privmsg>(&response))
+    {
+        privmsg->channelAtom = atoms.intern(privmsg->channel());
+        privmsg->nickAtom = atoms.intern(privmsg->nick());
+
+        return privmsg->channelAtom != NO_ATOM && privmsg->nickAtom != NO_ATOM;
+    }
+    else if (Part* part = std::get_if<Part>(&response))
+    {
+        part->channelAtom = atoms.intern(part->channel());
+        part->nickAtom = atoms.intern(part->nick());
+
+        if (part->channelAtom == NO_ATOM || part->nickAtom == NO_ATOM)
+        {
+            return false;
+        }
+
+        if (isSelf(part->nickAtom))
+        {
+            forgetChannel(part->channel());
+        }
+    }
+    else if (Quit* quit = std::get_if<Quit>(&response))
+    {
+        quit->nickAtom = atoms.intern(quit->nick());
+
+        return quit->nickAtom != NO_ATOM;
+    }
+    else if (Nick* nick = std::get_if<Nick>(&response))
+    {
+        nick->nickAtom = atoms.intern(nick->nick());
+        nick->newNickAtom = atoms.intern(nick->newNick());
+
+        if (nick->nickAtom == NO_ATOM || nick->newNickAtom == NO_ATOM)
+        {
+            return false;
+        }
+
+        // reconnects ask for the nick we ended up with
+        if (isSelf(nick->nickAtom))
+        {
+            registration.nick = nick->newNick();
+            self.store(nick->newNickAtom, std::memory_order_release);
+        }
+    }
+    else if (Kick* kick = std::get_if<Kick>(&response))
+    {
+        kick->nickAtom = atoms.intern(kick->nick());
+        kick->channelAtom = atoms.intern(kick->channel());
+        kick->targetAtom = atoms.intern(kick->target());
+
+        if (kick->nickAtom == NO_ATOM || kick->channelAtom == NO_ATOM
+            || kick->targetAtom == NO_ATOM)
+        {
+            return false;
+        }
+
+        // not rejoined on reconnect
+        if (isSelf(kick->targetAtom))
+        {
+            forgetChannel(kick->channel());
+        }
+    }
+    else if (Names* names = std::get_if<Names>(&response))
+    {
+        names->channelAtom = atoms.intern(names->channel());
+        std::string_view list = names->names();
+
+        if (names->channelAtom == NO_ATOM)
+        {
+            return false;
+        }
+
+        for (size_t begin = 0; begin < list.size();)
+        {
+            size_t end = std::min(list.find(' ', begin), list.size());
+            std::string_view name = list.substr(begin, end - begin);
+            begin = end + 1;
+
+            // multi-prefix lists every mode, highest first; userhost-in-names
+            // adds !user@host
+            size_t nickStart = name.find_first_not_of(namesPrefixes);
+            char prefix = nickStart > 0 && nickStart != std::string_view::npos
+                ? name.front() : 0;
+            name = name.substr(std::min(nickStart, name.size()));
+            name = name.substr(0, name.find('!'));
+
+            if (name.empty())
+            {
+                continue;
+            }
+
+            Atom nick = atoms.intern(name);
+
+            if (nick == NO_ATOM)
+            {
+                return false;
+            }
+
+            names->members.push_back(Roster::Member{nick, prefix});
+        }
+    }
+
+    return true;
+}
+
+void Server::reportStatus(response::Status::State state, std::string detail)
+{
+    queueResponse(response::Status(state, std::move(detail)));
+    notifyQueued();
+}
+
+void Server::disconnect()
+{
+    // let queued lines such as QUIT go out first, but don't wait on a stuck
+    // socket for ever. closing aborts the pending read, after which no
+    // handler of this server is left to run
+    asio::post(strand, [this, op = beginOp()]
+    {
+        closing = true;
+
+        if (!socket.is_open())
+        {
+            closeSocket();
+            return;
+        }
+
+        floodTimer.cancel();
+        closeTimer.expires_after(std::chrono::seconds(2));
+        closeTimer.async_wait([this, op = beginOp()](
+            const asio::error_code& error)
+        {
+            if (!error)
+            {
+                closeSocket();
+            }
+        });
+
+        flushOutbound();
+    });
+
+    std::unique_lock lock(pendingMutex);
+    pendingDone.wait(lock, [this] { return pendingOps == 0; });
+    connected = false;
+}
+
+Server::PendingOp::PendingOp(Server* server) : server(server) { }
+
+Server::PendingOp::PendingOp(PendingOp&& other) noexcept
+    : server(std::exchange(other.server, nullptr)) { }
+
+Server::PendingOp::~PendingOp()
+{
+    if (!server)
     {
         return;
     }
 
-    asio::connect(socket, endpoints);
-    connected = true;
-    queueResponsesThread = std::thread(&Server::queueResponses, this);
-    queueResponsesThread.detach();
+    std::lock_guard lock(server->pendingMutex);
+
+    if (--server->pendingOps == 0)
+    {
+        server->pendingDone.notify_all();
+    }
+}
+
+Server::PendingOp Server::beginOp()
+{
+    std::lock_guard lock(pendingMutex);
+    ++pendingOps;
+
+    return PendingOp(this);
+}
+
+const std::string& Server::getHost() const
+{
+    return host;
+}
+
+const AtomTable& Server::getAtoms() const
+{
+    return atoms;
 }
 
+bool Server::isSelf(Atom nick) const
+{
+    return nick == self.load(std::memory_order_acquire);
+}
+
+Atom Server::getSelf() const
+{
+    return self.load(std::memory_order_acquire);
+}
+
+Roster& Server::getRoster()
+{
+    return roster;
+}
+
+void Server::shutdownSocket()
+{
+    asio::error_code ignored;
+    socket.shutdown(tcp::socket::shutdown_both, ignored);
+    socket.close(ignored);
+    backlogTimer.cancel();
+    floodTimer.cancel();
+}
+
+void Server::closeSocket()
+{
+    resolver.cancel();
+    attemptTimer.cancel();
+    attempts.clear();
+    connecting = false;
+    reconnectTimer.cancel();
+    closeTimer.cancel();
+    shutdownSocket();
+}
+
+void Server::flushOutbound()
+{
+    if (writing || !socket.is_open())
+    {
+        return;
+    }
+
+    // on the way out everything left is sent regardless of the bucket
+    std::optional<OutboundQueue::clock::duration> retryAfter {
+        outbound.take(writeBatch, closing)
+    };
+
+    if (retryAfter && !floodWait)
+    {
+        floodWait = true;
+        floodTimer.expires_after(*retryAfter);
+        floodTimer.async_wait([this, op = beginOp()](
+            const asio::error_code& error)
+        {
+            floodWait = false;
+
+            if (!error)
+            {
+                flushOutbound();
+            }
+        });
+    }
+
+    if (writeBatch.empty())
+    {
+        if (closing)
+        {
+            closeSocket();
+        }
+
+        return;
+    }
+
+    writeBuffers.clear();
+    for (const std::string& line : writeBatch)
+    {
+        writeBuffers.push_back(asio::buffer(line));
+    }
+
+    writing = true;
+    asio::async_write(socket, writeBuffers,
+        [this, id = connection, op = beginOp()](const asio::error_code& error,
+            size_t)
+        {
+            writing = false;
+            outbound.recycle(writeBatch);
+
+            if (error && id == connection)
+            {
+                connectionLost(error.message());
+                return;
+            }
+
+            flushOutbound();
+        });
+}
+
+// registration and channel membership are kept on the reactor so they can
+// be replayed after a reconnect; lines go out once the server can take them
+
 void Server::nick(std::string_view value)
 {
-    send(std::string("NICK ").append(value));
+    asio::post(strand, [this, value = std::string(value), op = beginOp()]
+    {
+        registration.nick = value;
+        self.store(atoms.intern(value), std::memory_order_release);
+
+        if (connected)
+        {
+            send({"NICK ", value}, OutboundQueue::Priority::URGENT);
+        }
+    });
 }
 
 void Server::auth(std::string_view username, std::string_view realname)
 {
-    send(std::string("USER ").append(username).append(" 0 * :")
-        .append(realname));
+    asio::post(strand, [this, username = std::string(username),
+        realname = std::string(realname), op = beginOp()]
+    {
+        registration.username = username;
+        registration.realname = realname;
+
+        if (connected && !registered)
+        {
+            send({"USER ", username, " 0 * :", realname},
+                OutboundQueue::Priority::URGENT);
+        }
+    });
 }
 
 void Server::join(std::string_view channel)
 {
-    send(std::string("JOIN ").append(channel));
+    asio::post(strand, [this, channel = std::string(channel), op = beginOp()]
+    {
+        size_t begin = 0;
+
+        while (begin <= channel.size())
+        {
+            size_t comma = std::min(channel.find(',', begin), channel.size());
+
+            if (comma > begin)
+            {
+                rememberChannel(std::string_view(channel).substr(begin,
+                    comma - begin));
+            }
+
+            begin = comma + 1;
+        }
+
+        if (registered)
+        {
+            send({"JOIN ", channel}, OutboundQueue::Priority::BULK);
+        }
+    });
 }
 
 void Server::privmsg(std::string_view channel, std::string_view message)
 {
-    send(std::string("PRIVMSG ").append(channel).append(" :").append(message));
+    send({"PRIVMSG ", channel, " :", message},
+        OutboundQueue::Priority::INTERACTIVE);
 }
 
 void Server::quit()
 {
-    send("QUIT");
-    connected = false;
+    quitting = true;
+    send({"QUIT"}, OutboundQueue::Priority::URGENT);
 }
 
 void Server::quit(std::string_view message)
 {
-    send(std::string("QUIT :").append(message));
-    connected = false;
+    quitting = true;
+    send({"QUIT :", message}, OutboundQueue::Priority::URGENT);
 }
 
 void Server::send(std::string_view message)
 {
-    asio::write(socket, asio::buffer(std::string(message).append("\r\n")));
+    send({message}, OutboundQueue::classify(message));
+}
+
+void Server::send(std::initializer_list<std::string_view> parts)
+{
+    send(parts, OutboundQueue::classify(parts.size() ? *parts.begin() : ""));
+}
+
+void Server::send(std::initializer_list<std::string_view> parts,
+    OutboundQueue::Priority priority)
+{
+    if (replaying)
+    {
+        return;
+    }
+
+    std::string line = outbound.acquire();
+
+    for (std::string_view part : parts)
+    {
+        line.append(part);
+    }
+
+    line.append("\r\n");
+
+    // the write itself happens on the reactor, never on the caller's thread
+    if (outbound.push(std::move(line), priority))
+    {
+        asio::post(strand, [this, op = beginOp()] { flushOutbound(); });
+    }
 }
 
 void Server::part(std::string_view channel)
 {
-    send(std::string("PART ").append(channel));
+    part(channel, std::string_view());
 }
 
 void Server::part(std::string_view channel, std::string_view message)
 {
-    send(std::string("PART ").append(channel).append(" :").append(message));
+    asio::post(strand, [this, channel = std::string(channel),
+        message = std::string(message), op = beginOp()]
+    {
+        forgetChannel(channel);
+
+        if (!registered)
+        {
+            return;
+        }
+
+        if (message.empty())
+        {
+            send({"PART ", channel}, OutboundQueue::Priority::INTERACTIVE);
+        }
+        else
+        {
+            send({"PART ", channel, " :", message},
+                OutboundQueue::Priority::INTERACTIVE);
+        }
+    });
 }
 
-std::vector<response::responseVarient> Server::fetch()
+void Server::setFloodControl(OutboundQueue::FloodControl floodControl)
 {
-    queueMutex.lock();
-    std::vector<response::responseVarient> result(responseQueue);
-    responseQueue.clear();
-    queueMutex.unlock();
+    outbound.setFloodControl(floodControl);
+}
 
-    return result;
+std::array<OutboundQueue::Stats, OutboundQueue::PRIORITY_COUNT>
+    Server::sendStats()
+{
+    return outbound.getStats();
+}
+
+size_t Server::fetch(std::vector<response::responseVarient>& responses)
+{
+    notified.exchange(false);
+    return responseQueue.popAll(responses);
+}
+
+void Server::setNotify(std::function<void()> notify)
+{
+    this->notify = std::move(notify);
+}
+
+size_t Server::queueDepth() const
+{
+    return responseQueue.size();
+}
+
+size_t Server::maxQueueDepth() const
+{
+    return maxDepth.load(std::memory_order_relaxed);
 }
 
 User::User(std::string nick, std::string username)
@@ -158,5 +1073,5 @@ User::~User() { }
 
 void User::privmsg(std::string content)
 {
-    server->send("PRIVMSG " + nick + " :" + content);
+    server->send({"PRIVMSG ", nick, " :", content});
 }
@@ -1,9 +1,28 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <asio.hpp>
 #include <variant>
+#include "atom_table.hpp"
+#include "capture.hpp"
+#include "expected.hpp"
+#include "line_framer.hpp"
+#include "message.hpp"
+#include "outbound_queue.hpp"
+#include "roster.hpp"
+#include "spsc_queue.hpp"
 
 using asio::ip::tcp;
 
@@ -15,74 +34,87 @@ namespace irc
 
     namespace response
     {
-        class ParseError : public std::exception
+        class ParseError
         {
-            std::string error;
-            std::vector<std::string>& words;
+            const char* error;
         public:
-            ParseError(std::string error, std::vector<std::string>& words);
-            const char* what() const noexcept override;
+            constexpr ParseError(const char* error) : error(error) { }
+            const char* what() const noexcept;
         };
 
         class Response
         {
         public:
-            std::vector<std::string> words;
+            Message parsed;
             enum ResponseType
             {
                 NUMERIC,
                 JOIN,
                 PRIVMSG,
-                PART
+                PART,
+                PING,
+                QUIT,
+                NICK,
+                KICK
             };
 
-            Response(std::vector<std::string> words);
+            Response(Message message);
         };
 
+        // the atoms of responses naming nicks and channels are interned by
+        // the Server before the response is queued
+
         class Join : public Response
         {
         public:
-            std::string channel;
-            std::string nick;
-            Join(std::vector<std::string> words);
+            std::string_view channel() const;
+            std::string_view nick() const;
+            Atom channelAtom = 0;
+            Atom nickAtom = 0;
+            Join(Message message);
         };
 
         class Ping : public Response
         {
         public:
-            std::string code;
+            std::string_view code() const;
             void pong(Server& server);
-            Ping(std::vector<std::string> words);
+            Ping(Message message);
         };
 
         class Privmsg : public Response
         {
         public:
-            std::string channel;
-            std::string nick;
-            std::string message;
-            Privmsg(std::vector<std::string> words);
+            std::string_view channel() const;
+            std::string_view nick() const;
+            std::string_view message() const;
+            Atom channelAtom = 0;
+            Atom nickAtom = 0;
+            Privmsg(Message message);
         };
 
         class Part : public Response
         {
         public:
-            std::string nick;
-            std::string channel;
-            std::optional<std::string> message;
-            Part(std::vector<std::string> words);
+            std::string_view nick() const;
+            std::string_view channel() const;
+            std::optional<std::string_view> message() const;
+            Atom channelAtom = 0;
+            Atom nickAtom = 0;
+            Part(Message message);
         };
 
         class Numeric : public Response
         {
         public:
-            enum NumericID
+            enum NumericID : uint16_t
             {
                 RPL_WELCOME = 001,
                 RPL_YOURHOST = 002,
                 RPL_CREATED = 003,
                 RPL_MYINFO = 004,
                 RPL_BOUNCE = 005,
+                RPL_ISUPPORT = 005,
                 RPL_TRACELINK = 200,
                 RPL_TRACECONNECTING = 201,
                 RPL_TRACEHANDSHAKE = 202,
@@ -216,8 +248,75 @@ namespace irc
                 ERR_USERSDONTMATCH = 502,
             };
 
-            int numericID;
-            Numeric(std::vector<std::string> words, int numericID);
+            NumericID numericID;
+            Numeric(Message message, NumericID numericID);
+        };
+
+        // connection progress reported by the Server itself rather than
+        // received from the network
+        class Status
+        {
+        public:
+            enum State
+            {
+                RESOLVING,
+                CONNECTING,
+                CONNECTED,
+                FAILED,
+                DISCONNECTED,
+                RECONNECTING
+            };
+
+            State state;
+            std::string detail;
+            Status(State state, std::string detail = "");
+        };
+
+        class Quit : public Response
+        {
+        public:
+            std::string_view nick() const;
+            std::optional<std::string_view> message() const;
+            Atom nickAtom = 0;
+            Quit(Message message);
+        };
+
+        class Nick : public Response
+        {
+        public:
+            std::string_view nick() const;
+            std::string_view newNick() const;
+            Atom nickAtom = 0;
+            Atom newNickAtom = 0;
+            Nick(Message message);
+        };
+
+        class Kick : public Response
+        {
+        public:
+            // the kicker
+            std::string_view nick() const;
+            std::string_view channel() const;
+            std::string_view target() const;
+            std::optional<std::string_view> message() const;
+            Atom nickAtom = 0;
+            Atom channelAtom = 0;
+            Atom targetAtom = 0;
+            Kick(Message message);
+        };
+
+        // a line of RPL_NAMREPLY, or the RPL_ENDOFNAMES that completes the
+        // listing
+        class Names : public Numeric
+        {
+        public:
+            std::string_view channel() const;
+            // space separated, each with its mode prefixes
+            std::string_view names() const;
+            bool complete() const;
+            Atom channelAtom = 0;
+            std::vector<Roster::Member> members;
+            Names(Message message, NumericID numericID);
         };
 
         typedef std::variant<
@@ -226,32 +325,169 @@ namespace irc
             Join,
             Ping,
             Privmsg,
-            Part
+            Part,
+            Status,
+            Quit,
+            Nick,
+            Kick,
+            Names
         > responseVarient;
 
-        responseVarient readResponse(std::string raw);
+        typedef Expected<responseVarient, ParseError> ParseResult;
+
+        ParseResult readResponse(std::string_view raw);
     }
 
     class Server
     {
-        std::vector<User*> users;
         std::string host;
         std::string port;
-        asio::io_context io_context;
+        // every handler of this server runs here, so the reactor side is
+        // single threaded even when the io_context is run by a pool
+        asio::strand<asio::io_context::executor_type> strand;
         tcp::resolver resolver;
-        tcp::resolver::results_type endpoints;
         tcp::socket socket;
-        std::vector<response::responseVarient> responseQueue;
-        void queueResponses();
-        std::thread queueResponsesThread;
-        std::mutex queueMutex;
+
+        // happy eyeballs: staggered parallel attempts across the resolved
+        // endpoints, the first to connect becomes socket
+        std::vector<tcp::endpoint> candidates;
+        std::vector<std::unique_ptr<tcp::socket>> attempts;
+        asio::steady_timer attemptTimer;
+        size_t nextCandidate = 0;
+        size_t failedAttempts = 0;
+        bool connecting = false;
+        void resolved(const tcp::resolver::results_type& results);
+        void startAttempt();
+        void attemptFinished(tcp::socket* attempt,
+            const asio::error_code& error);
+        void reportStatus(response::Status::State state,
+            std::string detail = "");
+        void startConnect();
+        void connectFailed(const std::string& reason);
+
+        // reconnect and rejoin, reactor only. handlers of a lost connection
+        // see a stale connection id and leave the new one alone
+        struct Registration
+        {
+            std::string nick;
+            std::string username;
+            std::string realname;
+        } registration;
+        std::vector<Atom> channels;
+        bool registered = false;
+        unsigned connection = 0;
+        unsigned reconnectAttempt = 0;
+        asio::steady_timer reconnectTimer;
+        std::minstd_rand jitter{std::random_device{}()};
+        std::atomic_bool quitting{false};
+        void connectionLost(const std::string& reason);
+        void scheduleReconnect();
+        void sendRegistration();
+        void rejoinChannels();
+        void rememberChannel(std::string_view channel);
+        void forgetChannel(std::string_view channel);
+        // false when the response names more than the atom table can
+        // hold, and is to be dropped
+        bool trackState(response::responseVarient& response);
+
+        // nicks and channel names seen on this network; self is written on
+        // the reactor and read by the ui
+        AtomTable atoms;
+        std::atomic<Atom> self{NO_ATOM};
+        Roster roster;
+        // mode prefixes from ISUPPORT PREFIX, stripped off NAMES entries on
+        // the reactor
+        std::string namesPrefixes = "~&@%+";
+
+        LineFramer framer;
+        SpscQueue<response::responseVarient> responseQueue{4096};
+        // reactor-side overflow held while the ui thread is behind
+        std::deque<response::responseVarient> responseBacklog;
+        asio::steady_timer backlogTimer;
+        std::atomic<size_t> maxDepth{0};
+        // set once the ui has been told about queued responses, cleared by
+        // fetch() so each drain of the queue costs at most one wakeup
+        std::function<void()> notify;
+        std::atomic_bool notified{false};
+        void notifyQueued();
+        void readResponses();
+        void queueResponses(size_t readLen);
+        void queueResponse(response::responseVarient&& response);
+        bool flushBacklog();
+        OutboundQueue outbound;
+        // reactor-side state of the write in flight
+        std::vector<std::string> writeBatch;
+        std::vector<asio::const_buffer> writeBuffers;
+        bool writing = false;
+        bool closing = false;
+        asio::steady_timer floodTimer;
+        bool floodWait = false;
+        asio::steady_timer closeTimer;
+        void flushOutbound();
+        void shutdownSocket();
+        void closeSocket();
+
+        // capture and replay of received bytes, reactor only
+        std::unique_ptr<CaptureWriter> captureFile;
+        std::unique_ptr<CaptureReader> replayFile;
+        std::optional<CaptureReader::Chunk> replayChunk;
+        std::chrono::steady_clock::time_point replayStart;
+        bool replayPaced = false;
+        // from replay() until the next connect(); send() on any thread drops
+        // lines such as PONGs rather than queue them for a socket that
+        // never opens
+        std::atomic_bool replaying{false};
+        void replayNext();
+        void endReplay(response::Status::State state, std::string detail);
         std::atomic_bool connected{false};
 
+        // handlers still queued on the io_context; disconnect() waits for
+        // them so none can run against a destroyed Server
+        class PendingOp
+        {
+            Server* server;
+        public:
+            PendingOp(Server* server);
+            PendingOp(PendingOp&& other) noexcept;
+            PendingOp(const PendingOp&) = delete;
+            ~PendingOp();
+        };
+
+        std::mutex pendingMutex;
+        std::condition_variable pendingDone;
+        size_t pendingOps = 0;
+        PendingOp beginOp();
+
     public:
-        Server(std::string host, std::string port);
+        Server(asio::io_context& io_context, std::string host,
+            std::string port);
         ~Server();
         void connect();
-        std::vector<response::responseVarient> fetch();
+        void disconnect();
+        const std::string& getHost() const;
+        const AtomTable& getAtoms() const;
+        // whether the nick is the one this client holds on the network
+        bool isSelf(Atom nick) const;
+        // that nick, NO_ATOM before one is set
+        Atom getSelf() const;
+        // kept by the thread that consumes this server's responses
+        Roster& getRoster();
+
+        size_t fetch(std::vector<response::responseVarient>& responses);
+        template<typename F> size_t fetch(F&& consumer);
+        size_t queueDepth() const;
+        size_t maxQueueDepth() const;
+        // called on the reactor when responses become ready to fetch; set
+        // before connect()
+        void setNotify(std::function<void()> notify);
+
+        // record every byte received to path, or feed a capture through the
+        // parser in place of a connection, either at its original pace or
+        // as fast as the ui takes it. both throw CaptureError if the file
+        // cannot be opened; a corrupt record later ends the replay as
+        // FAILED. nothing is sent from replay() until the next connect()
+        void capture(const std::string& path);
+        void replay(const std::string& path, bool paced);
 
         // messages
         void nick(std::string_view value);
@@ -261,10 +497,25 @@ namespace irc
         void quit();
         void quit(std::string_view message);
         void send(std::string_view command);
+        void send(std::initializer_list<std::string_view> parts);
+        void send(std::initializer_list<std::string_view> parts,
+            OutboundQueue::Priority priority);
         void part(std::string_view channel);
         void part(std::string_view channel, std::string_view message);
+
+        // outbound rate limiting and per-priority queue latency
+        void setFloodControl(OutboundQueue::FloodControl floodControl);
+        std::array<OutboundQueue::Stats, OutboundQueue::PRIORITY_COUNT>
+            sendStats();
     };
 
+    template<typename F>
+    size_t Server::fetch(F&& consumer)
+    {
+        notified.exchange(false);
+        return responseQueue.consumeAll(std::forward<F>(consumer));
+    }
+
     class MessageTarget
     {
     protected:
@@ -283,7 +534,4 @@ namespace irc
         std::string username;
         void privmsg(std::string content) override;
     };
-
-    // TODO: set this based on server response
-    inline std::string userNick { "silvermantis" };
 }
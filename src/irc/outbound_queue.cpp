@@ -0,0 +1,162 @@
+#include "outbound_queue.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace irc;
+
+// lines above this size are not worth keeping around for reuse
+#define MAX_POOLED_CAPACITY 1024
+#define MAX_POOLED_BUFFERS 64
+
+OutboundQueue::Priority OutboundQueue::classify(std::string_view line)
+{
+    std::string_view command = line.substr(0, line.find(' '));
+
+    if (command == "PONG" || command == "QUIT" || command == "PASS"
+        || command == "USER" || command == "CAP")
+    {
+        return URGENT;
+    }
+
+    if (command == "JOIN" || command == "WHO" || command == "NAMES"
+        || command == "LIST" || command == "WHOIS")
+    {
+        return BULK;
+    }
+
+    return INTERACTIVE;
+}
+
+std::string OutboundQueue::acquire()
+{
+    std::lock_guard lock(mutex);
+
+    if (pool.empty())
+    {
+        return std::string();
+    }
+
+    std::string buffer = std::move(pool.back());
+    pool.pop_back();
+
+    return buffer;
+}
+
+size_t OutboundQueue::queuedCount() const
+{
+    size_t count = 0;
+
+    for (const std::deque<Entry>& lines : queued)
+    {
+        count += lines.size();
+    }
+
+    return count;
+}
+
+bool OutboundQueue::push(std::string&& line, Priority priority)
+{
+    std::lock_guard lock(mutex);
+
+    bool wasEmpty = queuedCount() == 0;
+    queued[priority].push_back(Entry { std::move(line), clock::now() });
+    ++stats[priority].queued;
+
+    return wasEmpty;
+}
+
+std::optional<OutboundQueue::clock::duration> OutboundQueue::take(
+    std::vector<std::string>& batch, bool unlimited)
+{
+    std::lock_guard lock(mutex);
+
+    unlimited = unlimited || limits.linesPerSecond == 0;
+
+    const clock::time_point now = clock::now();
+    tokens = std::min(limits.burst, tokens + limits.linesPerSecond
+        * std::chrono::duration<double>(now - refilled).count());
+    refilled = now;
+
+    for (int priority = URGENT; priority < PRIORITY_COUNT; ++priority)
+    {
+        std::deque<Entry>& lines = queued[priority];
+        Stats& stat = stats[priority];
+
+        while (!lines.empty() && (unlimited || tokens >= 1))
+        {
+            clock::duration waited = now - lines.front().queuedAt;
+            stat.totalWait += waited;
+            stat.maxWait = std::max(stat.maxWait, waited);
+            --stat.queued;
+            ++stat.sent;
+
+            batch.push_back(std::move(lines.front().line));
+            lines.pop_front();
+            tokens = std::max(0.0, tokens - 1);
+        }
+    }
+
+    if (queuedCount() == 0)
+    {
+        return std::nullopt;
+    }
+
+    return std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>((1 - tokens) / limits.linesPerSecond));
+}
+
+void OutboundQueue::recycle(std::vector<std::string>& batch)
+{
+    std::lock_guard lock(mutex);
+
+    for (std::string& line : batch)
+    {
+        if (pool.size() < MAX_POOLED_BUFFERS
+            && line.capacity() <= MAX_POOLED_CAPACITY)
+        {
+            line.clear();
+            pool.push_back(std::move(line));
+        }
+    }
+
+    batch.clear();
+}
+
+void OutboundQueue::clear()
+{
+    std::lock_guard lock(mutex);
+
+    for (int priority = URGENT; priority < PRIORITY_COUNT; ++priority)
+    {
+        queued[priority].clear();
+        stats[priority].queued = 0;
+    }
+}
+
+void OutboundQueue::setFloodControl(FloodControl floodControl)
+{
+    std::lock_guard lock(mutex);
+
+    // written so NaN falls to the same side as 0
+    if (!(floodControl.linesPerSecond > 0)
+        || std::isinf(floodControl.linesPerSecond))
+    {
+        floodControl.linesPerSecond = 0;
+    }
+
+    if (!(floodControl.burst >= 1))
+    {
+        floodControl.burst = 1;
+    }
+
+    limits = floodControl;
+    tokens = std::min(tokens, limits.burst);
+}
+
+std::array<OutboundQueue::Stats, OutboundQueue::PRIORITY_COUNT>
+    OutboundQueue::getStats()
+{
+    std::lock_guard lock(mutex);
+
+    return stats;
+}
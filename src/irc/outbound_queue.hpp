@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace irc
+{
+    // lines waiting to be written to a server. any thread may push; the
+    // reactor takes what the flood limit allows, highest priority first, for
+    // a single gather write and then hands the buffers back so their storage
+    // is reused for later lines
+    class OutboundQueue
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        enum Priority
+        {
+            URGENT,      // PONG, QUIT, registration
+            INTERACTIVE, // PRIVMSG, PART, NICK and anything unclassified
+            BULK,        // JOIN, WHO, NAMES, LIST
+            PRIORITY_COUNT
+        };
+
+        // token bucket; the defaults follow the classic ircd rule of two
+        // seconds per line with up to ten seconds of credit. a rate that is
+        // not positive and finite, such as 0, lifts the limit, and burst is
+        // at least the one line
+        struct FloodControl
+        {
+            double burst = 5;
+            double linesPerSecond = 0.5;
+        };
+
+        struct Stats
+        {
+            size_t queued = 0;
+            size_t sent = 0;
+            clock::duration totalWait{};
+            clock::duration maxWait{};
+        };
+
+    private:
+        struct Entry
+        {
+            std::string line;
+            clock::time_point queuedAt;
+        };
+
+        std::mutex mutex;
+        std::array<std::deque<Entry>, PRIORITY_COUNT> queued;
+        std::array<Stats, PRIORITY_COUNT> stats;
+        std::vector<std::string> pool;
+        FloodControl limits;
+        double tokens = limits.burst;
+        clock::time_point refilled = clock::now();
+
+        size_t queuedCount() const;
+
+    public:
+        static Priority classify(std::string_view line);
+
+        // an empty buffer, reusing the capacity of an already written line
+        std::string acquire();
+
+        // true if the queue was empty, i.e. the caller should schedule a flush
+        bool push(std::string&& line, Priority priority);
+
+        // move as many lines as the bucket allows onto the end of batch,
+        // urgent ones first. if lines are left behind, returns how long until
+        // the next one may be sent. unlimited ignores the bucket
+        std::optional<clock::duration> take(std::vector<std::string>& batch,
+            bool unlimited = false);
+
+        // return written lines to the pool and empty batch
+        void recycle(std::vector<std::string>& batch);
+
+        void clear();
+
+        void setFloodControl(FloodControl floodControl);
+        std::array<Stats, PRIORITY_COUNT> getStats();
+    };
+}
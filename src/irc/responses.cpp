@@ -1,186 +1,341 @@
 #include "network.hpp"
-#include <algorithm>
-#include <exception>
-#include <iterator>
-#include <numeric>
+#include <array>
+#include <charconv>
+#include <cstdint>
 #include <optional>
-#include <stdexcept>
 #include <string>
-#include <unordered_map>
-#include <vector>
+#include <string_view>
 
 using namespace irc::response;
 
-ParseError::ParseError(std::string error, std::vector<std::string>& words)
-    : error(std::move(error))
-    , words(words)
+const char* ParseError::what() const noexcept
 {
-    if (this->words.empty())
+    return error;
+}
+
+namespace
+{
+    constexpr uint32_t commandHash(std::string_view command)
     {
-        this->error += " : {EMPTY}";
-        return;
+        uint32_t hash = 2166136261u;
+
+        for (char c : command)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+
+        return hash;
     }
 
-    std::string wordsStr{std::accumulate(std::next(this->words.begin()),
-        this->words.end(), this->words.at(0), [](std::string acc, std::string
-        next) { return acc + ", " + next; })};
-    this->error += " : { " + std::move(wordsStr) + " }";
+    struct CommandEntry
+    {
+        std::string_view name;
+        Response::ResponseType type;
+    };
+
+    constexpr CommandEntry commandNames[] = {
+        {"JOIN", Response::ResponseType::JOIN},
+        {"PRIVMSG", Response::ResponseType::PRIVMSG},
+        {"PART", Response::ResponseType::PART},
+        {"PING", Response::ResponseType::PING},
+        {"QUIT", Response::ResponseType::QUIT},
+        {"NICK", Response::ResponseType::NICK},
+        {"KICK", Response::ResponseType::KICK},
+    };
+
+    // perfect hash: every name gets its own slot, checked at compile time
+    constexpr size_t COMMAND_TABLE_SIZE = 32;
+    constexpr auto commandTable = []
+    {
+        std::array<CommandEntry, COMMAND_TABLE_SIZE> table{};
+
+        for (const CommandEntry& entry : commandNames)
+        {
+            CommandEntry& slot {
+                table[commandHash(entry.name) % COMMAND_TABLE_SIZE]
+            };
+
+            if (!slot.name.empty())
+            {
+                throw "command hash collision, grow COMMAND_TABLE_SIZE";
+            }
+
+            slot = entry;
+        }
+
+        return table;
+    }();
+
+    constexpr std::optional<Response::ResponseType> lookupCommand(
+        std::string_view command)
+    {
+        const CommandEntry& slot {
+            commandTable[commandHash(command) % COMMAND_TABLE_SIZE]
+        };
+
+        if (slot.name != command)
+        {
+            return std::nullopt;
+        }
+
+        return slot.type;
+    }
+
+    static_assert(lookupCommand("PRIVMSG") == Response::ResponseType::PRIVMSG);
+    static_assert(!lookupCommand("NOTICE"));
+
+    constexpr std::optional<Numeric::NumericID> parseNumeric(
+        std::string_view command)
+    {
+        if (command.size() != 3)
+        {
+            return std::nullopt;
+        }
+
+        uint16_t numericID = 0;
+        auto [end, error] = std::from_chars(command.data(),
+            command.data() + command.size(), numericID);
+
+        if (error != std::errc() || end != command.data() + command.size())
+        {
+            return std::nullopt;
+        }
+
+        return static_cast<Numeric::NumericID>(numericID);
+    }
 }
 
-const char* ParseError::what() const noexcept
+ParseResult irc::response::readResponse(std::string_view raw)
 {
-    return error.c_str();
-}
+    Message message(raw);
 
-const std::unordered_map<std::string, Response::ResponseType> commandNames = {
-    {"JOIN", Response::ResponseType::JOIN},
-    {"PRIVMSG", Response::ResponseType::PRIVMSG},
-    {"PART", Response::ResponseType::PART},
-};
+    if (message.command().empty())
+    {
+        return Unexpected(ParseError("empty response received"));
+    }
 
-responseVarient irc::response::readResponse(std::string raw)
-{
-    std::vector<std::string> words;
-    std::string line; size_t pos;
-    for (int iter = 0; (pos = raw.find(' ')) != std::string::npos; iter++)
+    if (std::optional<Numeric::NumericID> numericID {
+        parseNumeric(message.command()) })
     {
-        words.push_back(raw.substr(0, pos));
-        raw = raw.substr(++pos);
+        if ((*numericID == Numeric::RPL_NAMREPLY && message.paramCount() >= 4)
+            || (*numericID == Numeric::RPL_ENDOFNAMES
+                && message.paramCount() >= 2))
+        {
+            return Names(std::move(message), *numericID);
+        }
+
+        return Numeric(std::move(message), *numericID);
     }
-    if (raw != "")
+
+    std::optional<Response::ResponseType> type {
+        lookupCommand(message.command())
+    };
+
+    if (!type)
     {
-        words.push_back(raw);
+        return Response(std::move(message));
     }
 
-    try
+    switch (*type)
     {
-        int numericID = std::stoi(words.at(2));
+    case Response::ResponseType::JOIN:
+        if (message.paramCount() < 1 || message.nick().empty())
+        {
+            return Unexpected(ParseError("malformed JOIN response received"));
+        }
 
-        if (numericID > 999)
+        return Join(std::move(message));
+    case Response::ResponseType::PRIVMSG:
+        if (message.paramCount() < 2 || message.nick().empty())
         {
-            throw std::exception();
+            return Unexpected(ParseError("malformed PRIVMSG recieved"));
         }
-        else
+
+        return Privmsg(std::move(message));
+    case Response::ResponseType::PART:
+        if (message.paramCount() < 1 || message.nick().empty())
         {
-            return Numeric(words, numericID);
+            return Unexpected(ParseError("malformed PART message received"));
         }
-    }
-    catch (std::exception& e)
-    {
-        try
+
+        return Part(std::move(message));
+    case Response::ResponseType::PING:
+        if (message.paramCount() < 1)
         {
-            if (words.at(0) == "PING")
-            {
-                return Ping(std::move(words));
-            }
+            return Unexpected(ParseError("PING response does not contain key"));
+        }
 
-            switch (commandNames.at(words.at(1)))
-            {
-            case Response::ResponseType::JOIN:
-                return Join(std::move(words));
-            case Response::ResponseType::PRIVMSG:
-                return Privmsg(std::move(words));
-            case Response::ResponseType::PART:
-                return Part(std::move(words));
-            default:
-                throw ParseError("Unable to determine command type", words);
-                break;
-            }
+        return Ping(std::move(message));
+    case Response::ResponseType::QUIT:
+        if (message.nick().empty())
+        {
+            return Unexpected(ParseError("malformed QUIT message received"));
         }
-        catch (std::out_of_range& e)
+
+        return Quit(std::move(message));
+    case Response::ResponseType::NICK:
+        if (message.paramCount() < 1 || message.nick().empty())
         {
-            return Response(std::move(words));
+            return Unexpected(ParseError("malformed NICK message received"));
         }
+
+        return Nick(std::move(message));
+    case Response::ResponseType::KICK:
+        if (message.paramCount() < 2 || message.nick().empty())
+        {
+            return Unexpected(ParseError("malformed KICK message received"));
+        }
+
+        return Kick(std::move(message));
+    default:
+        return Response(std::move(message));
     }
 }
 
-Response::Response(std::vector<std::string> words) : words(words) { }
+Response::Response(Message message) : parsed(std::move(message)) { }
 
-Numeric::Numeric(std::vector<std::string> words, int numericID)
-    : Response(std::move(words))
+Numeric::Numeric(Message message, NumericID numericID)
+    : Response(std::move(message))
     , numericID(numericID) { }
 
-Join::Join(std::vector<std::string> words) : Response(std::move(words))
+Join::Join(Message message) : Response(std::move(message)) { }
+
+std::string_view Join::channel() const
 {
-    try
-    {
-        channel = this->words.at(2);
-        nick = this->words.at(0).substr(1);
-        nick = nick.substr(0, nick.find('!'));
-    }
-    catch (std::exception& e)
-    {
-        throw ParseError("malformed JOIN response received", this->words);
-    }
+    return parsed.param(0);
 }
 
-Ping::Ping(std::vector<std::string> words) : Response(std::move(words))
+std::string_view Join::nick() const
 {
-    try
-    {
-        code = this->words.at(1);
-    }
-    catch (std::out_of_range& e)
-    {
-        throw ParseError("PING response does not contain key", this->words);
-    }
+    return parsed.nick();
 }
 
-Privmsg::Privmsg(std::vector<std::string> words) : Response(std::move(words))
+Ping::Ping(Message message) : Response(std::move(message)) { }
+
+std::string_view Ping::code() const
 {
-    try
-    {
-        nick = this->words.at(0).substr(1);
-        nick = nick.substr(0, nick.find('!'));
-        channel = this->words.at(2);
+    return parsed.param(0);
+}
 
-        message = std::accumulate(this->words.begin() + 4, this->words.end(),
-            this->words.at(3).substr(1), [](std::string acc, std::string next)
-            { return acc + ' ' + next; });
-    }
-    catch (std::out_of_range& e)
+Privmsg::Privmsg(Message message) : Response(std::move(message)) { }
+
+std::string_view Privmsg::channel() const
+{
+    return parsed.param(0);
+}
+
+std::string_view Privmsg::nick() const
+{
+    return parsed.nick();
+}
+
+std::string_view Privmsg::message() const
+{
+    return parsed.param(1);
+}
+
+Part::Part(Message message) : Response(std::move(message)) { }
+
+std::string_view Part::nick() const
+{
+    return parsed.nick();
+}
+
+std::string_view Part::channel() const
+{
+    return parsed.param(0);
+}
+
+std::optional<std::string_view> Part::message() const
+{
+    if (parsed.paramCount() < 2)
     {
-        throw ParseError("malformed PRIVMSG recieved", this->words);
+        return std::nullopt;
     }
+
+    return parsed.param(1);
+}
+
+Quit::Quit(Message message) : Response(std::move(message)) { }
+
+std::string_view Quit::nick() const
+{
+    return parsed.nick();
 }
 
-Part::Part(std::vector<std::string> words) : Response(std::move(words))
+std::optional<std::string_view> Quit::message() const
 {
-    if (this->words.size() >= 3)
+    if (parsed.paramCount() < 1)
     {
-        channel = this->words.at(2);
-        nick = std::string(std::next(
-            this->words.front().begin()),
-            std::find(std::next(
-                this->words.front().begin()),
-                this->words.front().end(),
-                '!'
-            )
-        );
-
-        if (this->words.size() >= 4)
-        {
-            message = std::accumulate(
-                this->words.begin() + 4,
-                this->words.end(),
-                this->words.at(3).substr(1),
-                [](std::string acc, std::string next) {
-                    return acc + ' ' + next;
-                }
-            );
-        }
-        else
-        {
-            message = std::nullopt;
-        }
+        return std::nullopt;
     }
-    else
+
+    return parsed.param(0);
+}
+
+Nick::Nick(Message message) : Response(std::move(message)) { }
+
+std::string_view Nick::nick() const
+{
+    return parsed.nick();
+}
+
+std::string_view Nick::newNick() const
+{
+    return parsed.param(0);
+}
+
+Kick::Kick(Message message) : Response(std::move(message)) { }
+
+std::string_view Kick::nick() const
+{
+    return parsed.nick();
+}
+
+std::string_view Kick::channel() const
+{
+    return parsed.param(0);
+}
+
+std::string_view Kick::target() const
+{
+    return parsed.param(1);
+}
+
+std::optional<std::string_view> Kick::message() const
+{
+    if (parsed.paramCount() < 3)
     {
-        throw ParseError("malformed PART message received", this->words);
+        return std::nullopt;
     }
+
+    return parsed.param(2);
 }
 
+Names::Names(Message message, NumericID numericID)
+    : Numeric(std::move(message), numericID) { }
+
+std::string_view Names::channel() const
+{
+    // <nick> <symbol> <channel> :<names> or <nick> <channel> :End of NAMES
+    return parsed.param(complete() ? 1 : 2);
+}
+
+std::string_view Names::names() const
+{
+    return complete() ? std::string_view() : parsed.param(3);
+}
+
+bool Names::complete() const
+{
+    return numericID == RPL_ENDOFNAMES;
+}
+
+Status::Status(State state, std::string detail)
+    : state(state)
+    , detail(std::move(detail)) { }
+
 void Ping::pong(Server& server)
 {
-    server.send("PONG " + code);
+    server.send({"PONG :", code()}, OutboundQueue::Priority::URGENT);
 }
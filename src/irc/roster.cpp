@@ -0,0 +1,291 @@
+#include "roster.hpp"
+#include <algorithm>
+
+using namespace irc;
+
+namespace
+{
+    bool byNick(const Roster::Member& a, const Roster::Member& b)
+    {
+        return a.nick < b.nick;
+    }
+
+    std::vector<Roster::Member>::iterator findMember(
+        std::vector<Roster::Member>& members, Atom nick)
+    {
+        auto found = std::lower_bound(members.begin(), members.end(),
+            Roster::Member{nick, 0}, byNick);
+
+        return found != members.end() && found->nick == nick ? found
+            : members.end();
+    }
+}
+
+void Roster::setPrefixes(std::string_view prefixes)
+{
+    this->prefixes = prefixes;
+}
+
+size_t Roster::rank(char prefix) const
+{
+    size_t found = prefix ? prefixes.find(prefix) : std::string::npos;
+
+    return found == std::string::npos ? prefixes.size() : found;
+}
+
+void Roster::names(Atom channel, std::span<const Member> members)
+{
+    auto found = channels.find(channel);
+
+    if (found != channels.end())
+    {
+        found->second.listing.insert(found->second.listing.end(),
+            members.begin(), members.end());
+    }
+}
+
+void Roster::endOfNames(Atom channel)
+{
+    auto found = channels.find(channel);
+
+    if (found == channels.end())
+    {
+        return;
+    }
+
+    Channel& entry = found->second;
+
+    // the listing is the whole truth, so it replaces the members outright
+    for (const Member& member : entry.members)
+    {
+        unlink(member.nick, channel);
+    }
+
+    std::sort(entry.listing.begin(), entry.listing.end(), byNick);
+    entry.listing.erase(std::unique(entry.listing.begin(),
+        entry.listing.end(), [](const Member& a, const Member& b)
+        {
+            return a.nick == b.nick;
+        }), entry.listing.end());
+
+    entry.members.swap(entry.listing);
+    entry.listing.clear();
+    entry.version = ++changes;
+
+    for (const Member& member : entry.members)
+    {
+        link(member.nick, channel);
+    }
+}
+
+void Roster::join(Atom channel, Atom nick, bool self)
+{
+    if (self)
+    {
+        // a fresh start, NAMES follows
+        drop(channel);
+        channels[channel].version = ++changes;
+    }
+
+    auto found = channels.find(channel);
+
+    if (found != channels.end())
+    {
+        addMember(channel, found->second, Member{nick, 0});
+    }
+}
+
+void Roster::part(Atom channel, Atom nick, bool self)
+{
+    if (self)
+    {
+        drop(channel);
+        return;
+    }
+
+    auto found = channels.find(channel);
+
+    if (found != channels.end())
+    {
+        removeMember(channel, found->second, nick);
+    }
+}
+
+std::vector<Atom> Roster::quit(Atom nick)
+{
+    auto found = memberOf.find(nick);
+
+    if (found == memberOf.end())
+    {
+        return {};
+    }
+
+    std::vector<Atom> left = std::move(found->second);
+    memberOf.erase(found);
+
+    for (Atom channel : left)
+    {
+        auto entry = channels.find(channel);
+
+        // the two maps should agree, but a slip must not erase end()
+        if (entry == channels.end())
+        {
+            continue;
+        }
+
+        auto member = findMember(entry->second.members, nick);
+
+        if (member != entry->second.members.end())
+        {
+            entry->second.members.erase(member);
+            entry->second.version = ++changes;
+        }
+    }
+
+    return left;
+}
+
+std::vector<Atom> Roster::rename(Atom from, Atom to)
+{
+    auto found = memberOf.find(from);
+
+    if (found == memberOf.end())
+    {
+        return {};
+    }
+
+    std::vector<Atom> in = found->second;
+
+    // a change of case alone keeps the atom
+    if (from == to)
+    {
+        return in;
+    }
+
+    for (Atom channel : in)
+    {
+        auto entry = channels.find(channel);
+        auto member = entry == channels.end() ? std::vector<Member>::iterator()
+            : findMember(entry->second.members, from);
+
+        // drop a link with no member behind it rather than follow it
+        if (entry == channels.end() || member == entry->second.members.end())
+        {
+            unlink(from, channel);
+            continue;
+        }
+
+        char prefix = member->prefix;
+
+        removeMember(channel, entry->second, from);
+        addMember(channel, entry->second, Member{to, prefix});
+    }
+
+    return in;
+}
+
+std::span<const Roster::Member> Roster::members(Atom channel) const
+{
+    auto found = channels.find(channel);
+
+    if (found == channels.end())
+    {
+        return {};
+    }
+
+    return found->second.members;
+}
+
+std::span<const Atom> Roster::channelsOf(Atom nick) const
+{
+    auto found = memberOf.find(nick);
+
+    if (found == memberOf.end())
+    {
+        return {};
+    }
+
+    return found->second;
+}
+
+uint32_t Roster::version(Atom channel) const
+{
+    auto found = channels.find(channel);
+
+    return found == channels.end() ? 0 : found->second.version;
+}
+
+void Roster::addMember(Atom channel, Channel& entry, Member member)
+{
+    auto at = std::lower_bound(entry.members.begin(), entry.members.end(),
+        member, byNick);
+
+    if (at != entry.members.end() && at->nick == member.nick)
+    {
+        return;
+    }
+
+    entry.members.insert(at, member);
+    entry.version = ++changes;
+    link(member.nick, channel);
+}
+
+void Roster::removeMember(Atom channel, Channel& entry, Atom nick)
+{
+    auto found = findMember(entry.members, nick);
+
+    if (found == entry.members.end())
+    {
+        return;
+    }
+
+    entry.members.erase(found);
+    entry.version = ++changes;
+    unlink(nick, channel);
+}
+
+void Roster::link(Atom nick, Atom channel)
+{
+    memberOf[nick].push_back(channel);
+}
+
+void Roster::unlink(Atom nick, Atom channel)
+{
+    auto found = memberOf.find(nick);
+
+    if (found == memberOf.end())
+    {
+        return;
+    }
+
+    std::vector<Atom>& in = found->second;
+    auto at = std::find(in.begin(), in.end(), channel);
+
+    if (at != in.end())
+    {
+        *at = in.back();
+        in.pop_back();
+    }
+
+    if (in.empty())
+    {
+        memberOf.erase(found);
+    }
+}
+
+void Roster::drop(Atom channel)
+{
+    auto found = channels.find(channel);
+
+    if (found == channels.end())
+    {
+        return;
+    }
+
+    for (const Member& member : found->second.members)
+    {
+        unlink(member.nick, channel);
+    }
+
+    channels.erase(found);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "atom_table.hpp"
+
+namespace irc
+{
+    // who is in each channel this client is in, and which of those
+    // channels each user is in. members are flat vectors sorted by atom,
+    // so a NAMES listing lands as one sort and a QUIT or NICK touches only
+    // the user's own channels. kept by the thread that consumes responses
+    class Roster
+    {
+    public:
+        struct Member
+        {
+            Atom nick;
+            // highest mode prefix such as '@' or '+', 0 for none
+            char prefix;
+        };
+
+        // mode prefixes from highest to lowest, from RPL_ISUPPORT PREFIX
+        void setPrefixes(std::string_view prefixes);
+        // lower ranks first, unprefixed members last
+        size_t rank(char prefix) const;
+
+        // one RPL_NAMREPLY, then RPL_ENDOFNAMES replaces the member list
+        void names(Atom channel, std::span<const Member> members);
+        void endOfNames(Atom channel);
+
+        void join(Atom channel, Atom nick, bool self);
+        // also kicks
+        void part(Atom channel, Atom nick, bool self);
+        // both return the channels the user was in
+        std::vector<Atom> quit(Atom nick);
+        std::vector<Atom> rename(Atom from, Atom to);
+
+        // empty for channels this client is not in
+        std::span<const Member> members(Atom channel) const;
+        std::span<const Atom> channelsOf(Atom nick) const;
+        // changes whenever the channel's members do
+        uint32_t version(Atom channel) const;
+
+    private:
+        struct Channel
+        {
+            std::vector<Member> members;
+            // a NAMES listing still coming in
+            std::vector<Member> listing;
+            uint32_t version = 0;
+        };
+
+        std::string prefixes = "~&@%+";
+        std::unordered_map<Atom, Channel> channels;
+        std::unordered_map<Atom, std::vector<Atom>> memberOf;
+        uint32_t changes = 0;
+
+        void addMember(Atom channel, Channel& entry, Member member);
+        void removeMember(Atom channel, Channel& entry, Atom nick);
+        void link(Atom nick, Atom channel);
+        void unlink(Atom nick, Atom channel);
+        void drop(Atom channel);
+    };
+}
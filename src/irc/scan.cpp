@@ -0,0 +1,196 @@
+#include "scan.hpp"
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define IRCTF_SCAN_X86
+#include <immintrin.h>
+#endif
+
+#if defined(IRCTF_SCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define IRCTF_SCAN_AVX2
+#endif
+
+using namespace irc;
+
+namespace
+{
+    size_t findScalar(const char* data, size_t size, char c)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (data[i] == c)
+            {
+                return i;
+            }
+        }
+
+        return size;
+    }
+
+    void findAllScalar(const char* data, size_t size, char c,
+        std::vector<uint32_t>& positions, uint32_t base)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (data[i] == c)
+            {
+                positions.push_back(base + i);
+            }
+        }
+    }
+
+#ifdef IRCTF_SCAN_X86
+    size_t findSse2(const char* data, size_t size, char c)
+    {
+        const __m128i needle = _mm_set1_epi8(c);
+        size_t i = 0;
+
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + i));
+            unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+            if (mask)
+            {
+                return i + std::countr_zero(mask);
+            }
+        }
+
+        return i + findScalar(data + i, size - i, c);
+    }
+
+    void findAllSse2(const char* data, size_t size, char c,
+        std::vector<uint32_t>& positions, uint32_t base)
+    {
+        const __m128i needle = _mm_set1_epi8(c);
+        size_t i = 0;
+
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + i));
+            unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+            for (; mask; mask &= mask - 1)
+            {
+                positions.push_back(base + i + std::countr_zero(mask));
+            }
+        }
+
+        findAllScalar(data + i, size - i, c, positions, base + i);
+    }
+#endif
+
+#ifdef IRCTF_SCAN_AVX2
+    __attribute__((target("avx2")))
+    void findAllAvx2(const char* data, size_t size, char c,
+        std::vector<uint32_t>& positions, uint32_t base)
+    {
+        const __m256i needle = _mm256_set1_epi8(c);
+        size_t i = 0;
+
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(data + i));
+            unsigned mask = _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(chunk, needle));
+
+            for (; mask; mask &= mask - 1)
+            {
+                positions.push_back(base + i + std::countr_zero(mask));
+            }
+        }
+
+        findAllSse2(data + i, size - i, c, positions, base + i);
+    }
+#endif
+
+    typedef size_t (*FindFn)(const char*, size_t, char);
+    typedef void (*FindAllFn)(const char*, size_t, char,
+        std::vector<uint32_t>&, uint32_t);
+
+    struct Dispatch
+    {
+        scan::Level level;
+        FindFn find;
+        FindAllFn findAll;
+    };
+
+    Dispatch select(scan::Level level)
+    {
+        switch (level)
+        {
+#ifdef IRCTF_SCAN_AVX2
+        case scan::Level::AVX2:
+            // message tokens are mostly shorter than one 32 byte step, so
+            // find stays on sse2 and only the framer's bulk scan widens
+            return { level, findSse2, findAllAvx2 };
+#endif
+#ifdef IRCTF_SCAN_X86
+        case scan::Level::SSE2:
+            return { scan::Level::SSE2, findSse2, findAllSse2 };
+#endif
+        default:
+            return { scan::Level::SCALAR, findScalar, findAllScalar };
+        }
+    }
+
+    Dispatch& dispatch()
+    {
+        static Dispatch current = select(scan::detected());
+        return current;
+    }
+}
+
+scan::Level scan::detected()
+{
+#ifdef IRCTF_SCAN_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Level::AVX2;
+    }
+#endif
+#ifdef IRCTF_SCAN_X86
+    // sse2 is part of the x86-64 baseline
+    return Level::SSE2;
+#else
+    return Level::SCALAR;
+#endif
+}
+
+scan::Level scan::level()
+{
+    return dispatch().level;
+}
+
+const char* scan::levelName(Level level)
+{
+    switch (level)
+    {
+    case Level::AVX2:
+        return "avx2";
+    case Level::SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+void scan::setLevel(Level level)
+{
+    dispatch() = select(std::min(level, detected()));
+}
+
+size_t scan::find(const char* data, size_t size, char c)
+{
+    return dispatch().find(data, size, c);
+}
+
+void scan::findAll(const char* data, size_t size, char c,
+    std::vector<uint32_t>& positions, uint32_t base)
+{
+    dispatch().findAll(data, size, c, positions, base);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// vectorised byte search used by the line framer and the message parser.
+// the widest instruction set the cpu supports is picked at startup for
+// findAll; find, which sees short tokens, tops out at sse2
+namespace irc::scan
+{
+    enum class Level
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    Level detected();
+    Level level();
+    const char* levelName(Level level);
+
+    // restrict dispatch to at most the given level, used by the benchmark
+    void setLevel(Level level);
+
+    // index of the first c in [data, data + size), or size if there is none
+    size_t find(const char* data, size_t size, char c);
+
+    // append base + index of every c in [data, data + size) to positions
+    void findAll(const char* data, size_t size, char c,
+        std::vector<uint32_t>& positions, uint32_t base = 0);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace irc
+{
+    // bounded lock-free queue for handing items from exactly one producer
+    // thread to exactly one consumer thread
+    template<typename T>
+    class SpscQueue
+    {
+        const size_t mask;
+        std::unique_ptr<std::optional<T>[]> slots;
+
+        // monotonic counters; size is tail - head, slot is counter & mask
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+
+    public:
+        // capacity is rounded up to a power of two
+        explicit SpscQueue(size_t capacity)
+            : mask{std::bit_ceil(capacity) - 1}
+            , slots{std::make_unique<std::optional<T>[]>(mask + 1)} { }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        // producer only; value is left untouched when the queue is full
+        bool tryPush(T&& value)
+        {
+            const size_t t = tail.load(std::memory_order_relaxed);
+
+            if (t - head.load(std::memory_order_acquire) > mask)
+            {
+                return false;
+            }
+
+            slots[t & mask].emplace(std::move(value));
+            tail.store(t + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // consumer only; hands everything currently queued to consumer as an
+        // rvalue, oldest first
+        template<typename F>
+        size_t consumeAll(F&& consumer)
+        {
+            const size_t h = head.load(std::memory_order_relaxed);
+            const size_t t = tail.load(std::memory_order_acquire);
+
+            for (size_t i = h; i != t; ++i)
+            {
+                std::optional<T>& slot = slots[i & mask];
+                consumer(std::move(*slot));
+                slot.reset();
+            }
+
+            head.store(t, std::memory_order_release);
+
+            return t - h;
+        }
+
+        // consumer only; moves everything currently queued onto the end of out
+        size_t popAll(std::vector<T>& out)
+        {
+            return consumeAll([&](T&& value) { out.push_back(std::move(value)); });
+        }
+
+        // approximate when read from a thread other than producer or consumer
+        size_t size() const
+        {
+            return tail.load(std::memory_order_acquire)
+                - head.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const
+        {
+            return mask + 1;
+        }
+    };
+}
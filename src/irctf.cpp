@@ -1,29 +1,113 @@
 #include <iostream>
 #include <memory>
 #include "gui/gui/log_item.hpp"
+#include "irc/connection_manager.hpp"
 #include "irc/network.hpp"
 #include "gui/gui.hpp"
 #include <math.h>
 #include "visit_response.hpp"
+#include "startup_trace.hpp"
+#include <future>
 #include <ranges>
 
-void runWindow(gui::Window& window, irc::Server& server);
+#define FONT_POLL_MS 10
+// nicks offered for one word, cycled through with repeated tabs
+#define COMPLETION_LIMIT 64
+
+void runWindow(gui::Window& window, irc::ConnectionManager& connections,
+    std::future<BLFontFace>& font);
 
 int main(int argc, char* argv[])
 {
     std::cout << " IRCTF v0.1 \n"
                  "############\n\n";
 
-    std::unique_ptr<irc::Server> server;
+    // bring the window up first; the font and the connections arrive in
+    // the background
+    std::unique_ptr<gui::Window> window;
+    std::future<BLFontFace> font;
 
     try
     {
-        server = std::make_unique<irc::Server>("localhost", "6667");
-        server->connect();
+        gui::init();
+        window = std::make_unique<gui::Window>(800, 600, "IRCTF");
+        font = gui::findFont();
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "GUI error: " << e.what() << '\n';
+        std::exit(-1);
+    }
+
+    startup_trace::mark("window created");
+
+    irc::ConnectionManager connections;
+
+    // the reactor wakes the ui loop when responses arrive; installed before
+    // any server connects or replays so it is never swapped under a reader
+    connections.setNotify(gui::wake);
+
+    try
+    {
+        // irctf [--capture file] [host[:port]]...
+        // irctf --replay file [--fast]
+        std::vector<std::string> networks;
+        std::string capturePath;
+        std::string replayPath;
+        bool paced = true;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg(argv[i]);
+
+            if (arg == "--capture" && i + 1 < argc)
+            {
+                capturePath = argv[++i];
+            }
+            else if (arg == "--replay" && i + 1 < argc)
+            {
+                replayPath = argv[++i];
+            }
+            else if (arg == "--fast")
+            {
+                paced = false;
+            }
+            else
+            {
+                networks.emplace_back(arg);
+            }
+        }
 
-        server->nick("silvermantis");
-        server->auth("silvermantis", "James");
-        server->join("#test");
+        if (!replayPath.empty())
+        {
+            connections.add(replayPath, "").replay(replayPath, paced);
+            networks.clear();
+        }
+        else if (networks.empty())
+        {
+            networks.push_back("localhost");
+        }
+
+        for (const std::string& network : networks)
+        {
+            size_t colon = network.rfind(':');
+            irc::Server& server = connections.add(network.substr(0, colon),
+                colon == std::string::npos ? "6667"
+                    : network.substr(colon + 1));
+
+            if (!capturePath.empty())
+            {
+                // one file per network when there are several
+                server.capture(networks.size() == 1 ? capturePath
+                    : capturePath + '.' + server.getHost());
+            }
+
+            // queued until registration can be sent
+            server.nick("silvermantis");
+            server.auth("silvermantis", "James");
+            server.join("#test");
+            server.connect();
+        }
     }
     catch(const std::exception& e)
     {
@@ -31,28 +115,29 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    std::unique_ptr<gui::Window> window;
+    runWindow(*window, connections, font);
 
-    try
+    for (const std::unique_ptr<irc::Server>& server : connections.getServers())
     {
-        gui::init();
-        window = std::make_unique<gui::Window>(800, 600, "IRCTF");
-    }
-    catch (std::exception& e)
-    {
-        std::cerr << "GUI error: " << e.what() << '\n';
-        std::exit(-1);
+        server->quit();
     }
 
-    runWindow(*window, *server);
+    // the reactor threads call gui::wake, so they stop before SDL does
+    connections.stop();
+    window.reset();
     gui::terminate();
 
-    server->quit();
+    gui::GlyphCache::Stats glyphStats = gui::glyphCache.getStats();
+    std::cout << "[+] glyph cache: " << glyphStats.hits << " hits, "
+        << glyphStats.misses << " misses, " << glyphStats.evictions
+        << " evictions, " << glyphStats.entries << " runs in "
+        << glyphStats.bytes / 1024 << " KiB\n";
 
     return 0;
 }
 
-void runWindow(gui::Window& window, irc::Server& server)
+void runWindow(gui::Window& window, irc::ConnectionManager& connections,
+    std::future<BLFontFace>& font)
 {
     using namespace gui;
 
@@ -61,9 +146,29 @@ void runWindow(gui::Window& window, irc::Server& server)
     std::unique_ptr<TabBar> tabBar{std::make_unique<TabBar>(window, 20, 15, 760,
         25)};
 
+    // the network the active tab belongs to; commands typed into the
+    // global tab go to the first network
+    auto activeServer = [&]() -> irc::Server*
+    {
+        const uint32_t network = networkOf(tabBar->activeTab->first->getKey);
+
+        for (const std::unique_ptr<irc::Server>& server
+            : connections.getServers())
+        {
+            if (network == 0 || server->getAtoms().id() == network)
+            {
+                return server.get();
+            }
+        }
+
+        return nullptr;
+    };
+
     std::function<void()> printInput = [&]
     {
-        if (tabBar->activeTab && !textBox->textBuffer.empty())
+        irc::Server* server = tabBar->activeTab ? activeServer() : nullptr;
+
+        if (server && !textBox->textBuffer.empty())
         {
             if (textBox->textBuffer.front() == '/')
             {
@@ -82,17 +187,17 @@ void runWindow(gui::Window& window, irc::Server& server)
                     if (commandWords.front() == "join"
                         && commandWords.size() == 2)
                     {
-                        server.join(commandWords.at(1));
+                        server->join(commandWords.at(1));
                     }
                     else if (commandWords.front() == "part")
                     {
                         if (commandWords.size() == 2)
                         {
-                            server.part(commandWords.at(1).data());
+                            server->part(commandWords.at(1).data());
                         }
                         else if (commandWords.size() >= 3)
                         {
-                            server.part(commandWords.at(1), std::string_view(
+                            server->part(commandWords.at(1), std::string_view(
                                 commandWords.at(2).begin(),
                                 commandWords.back().end()));
                         }
@@ -104,16 +209,21 @@ void runWindow(gui::Window& window, irc::Server& server)
                 }
             }
 
+            // the global tab has no atoms, so it gets our nick as text
+            const irc::Atom self { server->getSelf() };
+
             tabBar->activeTab->second.logMessage(log_item::Message {
-                std::time(nullptr), "nick",
-                textBox->textBuffer
+                std::time(nullptr),
+                tabBar->activeTab->first->getKey == TabBar::globalKey
+                    ? irc::NO_ATOM : self,
+                textBox->textBuffer,
+                self == irc::NO_ATOM ? "*" : server->getAtoms().name(self)
             });
 
-            auto activeChannel{tabBar->activeTab->first->getName};
-
-            if (activeChannel != "global")
+            if (tabBar->activeTab->first->getKey != TabBar::globalKey)
             {
-                server.privmsg(activeChannel, textBox->textBuffer);
+                server->privmsg(tabBar->activeTab->first->getName,
+                    textBox->textBuffer);
             }
 
             textBox->textBuffer.clear();
@@ -124,27 +234,69 @@ void runWindow(gui::Window& window, irc::Server& server)
         570, 100, 20, "send", std::move(printInput))};
     printInput = nullptr;
 
+    std::vector<irc::ConnectionManager::Fetched> responses;
+    bool firstFrame = true;
+
     for (;;)
     {
+        // sleep until input or network traffic; while the font is loading
+        // also look in on it now and then
+        SDL_Event event;
+        bool hasEvent = window.waitEvent(event, fontReady ? -1
+            : FONT_POLL_MS);
+
         float mouseX, mouseY;
         SDL_GetMouseState(&mouseX, &mouseY);
         Selectable::findFocus(mouseX, mouseY);
         Selectable* inFocus = Selectable::hovered;
 
         // read keyboard and mouse events
-        SDL_Event event;
-        while (window.pollEvents(event))
+        for (; hasEvent; hasEvent = window.pollEvents(event))
         {
             switch (event.type)
             {
             case SDL_EVENT_QUIT:
                 return;
+            case SDL_EVENT_WINDOW_SHOWN:
+            case SDL_EVENT_WINDOW_EXPOSED:
+            case SDL_EVENT_WINDOW_RESTORED:
+                window.invalidate();
+                break;
+            case SDL_EVENT_LOW_MEMORY:
+                // spill scrollback and drop whatever can be rebuilt
+                for (auto& [name, display] : tabBar->messageDisplays)
+                {
+                    display.second.trim();
+                }
+
+                glyphCache.clear();
+                break;
             case SDL_EVENT_MOUSE_BUTTON_DOWN:
                 if (inFocus)
                 {
                     inFocus->select();
                 }
 
+                break;
+            case SDL_EVENT_MOUSE_WHEEL:
+                // the member list scrolls under the pointer, the log
+                // anywhere else
+                if (tabBar->activeTab)
+                {
+                    MemberList& members = tabBar->activeTab->second.memberList;
+                    double distance = -event.wheel.y * 50;
+
+                    if (members.width > 0 && mouseX >= members.posX
+                        && mouseX < members.posX + members.width)
+                    {
+                        members.scroll(distance);
+                    }
+                    else
+                    {
+                        tabBar->activeTab->second.scroll(distance);
+                    }
+                }
+
                 break;
             case SDL_EVENT_KEY_DOWN:
                 if (Selectable::selected && Selectable::selected->selectType
@@ -171,13 +323,34 @@ void runWindow(gui::Window& window, irc::Server& server)
                     {
                         printButton->activate();
                     }
+                    else if (event.key.key == SDLK_TAB && tabBar->activeTab)
+                    {
+                        // channels from the open tabs, nicks from the
+                        // active channel's members
+                        static_cast<TextBox*>(Selectable::selected)->complete(
+                            [&](std::string_view word)
+                            {
+                                if (word.front() != '#')
+                                {
+                                    return tabBar->activeTab->second.memberList
+                                        .complete(word, COMPLETION_LIMIT);
+                                }
+
+                                irc::Server* server = activeServer();
+
+                                return tabBar->completeChannel(word, networkOf(
+                                    tabBar->activeTab->first->getKey), server
+                                    ? server->getAtoms().getCaseMapping()
+                                    : irc::CaseMapping::RFC1459);
+                            });
+                    }
                 }
 
                 if (event.key.key == SDLK_PAGEUP && tabBar->activeTab)
                 {
                     if (SDL_GetModState() & SDL_KMOD_CTRL)
                     {
-                        auto* target = &tabBar->messageDisplays.at("global");
+                        auto* target = &tabBar->messageDisplays.at(TabBar::globalKey);
 
                         // find tab to the left
                         for (auto msgDisplay = tabBar->messageDisplays.begin();
@@ -193,7 +366,7 @@ void runWindow(gui::Window& window, irc::Server& server)
                             }
                         }
 
-                        tabBar->activeTab = target;
+                        tabBar->setActiveTab(target);
                     }
                     else
                     {
@@ -230,7 +403,7 @@ void runWindow(gui::Window& window, irc::Server& server)
                             }
                         }
 
-                        tabBar->activeTab = target;
+                        tabBar->setActiveTab(target);
                     }
                     else
                     {
@@ -242,29 +415,50 @@ void runWindow(gui::Window& window, irc::Server& server)
 
         try
         {
-            for (irc::response::responseVarient response : server.fetch())
+            responses.clear();
+
+            connections.fetch(responses);
+
+            for (auto& [source, response] : responses)
             {
+#ifdef IRCTF_TRACE
                 std::cout << "[+] received message\n";
+#endif
 
                 switch (response.index())
                 {
                 case 0:
-                    visitResponse<0>(response, server, *tabBar);
+                    visitResponse<0>(response, *source, *tabBar);
                     break;
                 case 1:
-                    visitResponse<1>(response, server, *tabBar);
+                    visitResponse<1>(response, *source, *tabBar);
                     break;
                 case 2:
-                    visitResponse<2>(response, server, *tabBar);
+                    visitResponse<2>(response, *source, *tabBar);
                     break;
                 case 3:
-                    visitResponse<3>(response, server, *tabBar);
+                    visitResponse<3>(response, *source, *tabBar);
                     break;
                 case 4:
-                    visitResponse<4>(response, server, *tabBar);
+                    visitResponse<4>(response, *source, *tabBar);
                     break;
                 case 5:
-                    visitResponse<5>(response, server, *tabBar);
+                    visitResponse<5>(response, *source, *tabBar);
+                    break;
+                case 6:
+                    visitResponse<6>(response, *source, *tabBar);
+                    break;
+                case 7:
+                    visitResponse<7>(response, *source, *tabBar);
+                    break;
+                case 8:
+                    visitResponse<8>(response, *source, *tabBar);
+                    break;
+                case 9:
+                    visitResponse<9>(response, *source, *tabBar);
+                    break;
+                case 10:
+                    visitResponse<10>(response, *source, *tabBar);
                     break;
                 }
             }
@@ -275,12 +469,44 @@ void runWindow(gui::Window& window, irc::Server& server)
             return;
         }
 
-        window.clear();
+        if (!fontReady && font.valid() && font.wait_for(
+            std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            try
+            {
+                installFont(font.get());
+                startup_trace::mark("font loaded");
+                window.invalidate();
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << "GUI error: " << e.what() << '\n';
+                return;
+            }
+        }
+
+        // nothing changed, or nobody would see it
+        if (!window.damaged() || !window.visible())
+        {
+            continue;
+        }
 
-        textBox->draw();
-        printButton->draw();
-        tabBar->draw();
+        // widgets away from the damaged areas skip themselves
+        window.render([&]
+        {
+            // until the font arrives only the background is drawn
+            if (fontReady)
+            {
+                textBox->draw();
+                printButton->draw();
+                tabBar->draw();
+            }
+        });
 
-        window.display();
+        if (firstFrame)
+        {
+            startup_trace::mark("first frame");
+            firstFrame = false;
+        }
     }
 }
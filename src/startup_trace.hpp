@@ -0,0 +1,22 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+// timestamps of startup milestones (first frame, registration, ...) relative
+// to static initialisation, printed as they happen
+namespace startup_trace
+{
+    inline const std::chrono::steady_clock::time_point start {
+        std::chrono::steady_clock::now()
+    };
+
+    inline void mark(const char* event)
+    {
+        double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+        // one call so marks from the network threads don't interleave
+        std::printf("[t] %9.2f ms  %s\n", elapsed, event);
+    }
+}
@@ -4,6 +4,32 @@
 #include "gui/gui/log_item.hpp"
 #include "irc/network.hpp"
 #include "gui/gui.hpp"
+#include "startup_trace.hpp"
+
+// handlers echo what they handled to stdout only in builds with
+// IRCTF_TRACE, connection status aside; a busy channel would otherwise spend
+// the ui thread on the console
+
+// tabs are keyed by channel atom, so a channel is found whatever case a
+// message spells it in
+inline gui::ChannelKey channelKey(const irc::Server& server,
+    irc::Atom channel)
+{
+    return static_cast<gui::ChannelKey>(server.getAtoms().id()) << 32
+        | channel;
+}
+
+// the channel's nick list, or nullptr when it has no tab
+inline gui::MemberList* memberList(const irc::Server& server,
+    gui::TabBar& tabBar, irc::Atom channel)
+{
+    auto messageDisplay {
+        tabBar.messageDisplays.find(channelKey(server, channel))
+    };
+
+    return messageDisplay == tabBar.messageDisplays.end() ? nullptr
+        : &messageDisplay->second.second.memberList;
+}
 
 template<int T> void visitResponse(
     irc::response::responseVarient& varient,
@@ -19,7 +45,9 @@ template<> void visitResponse<0>(
     server,
     gui::TabBar& tabBar
 ) {
+#ifdef IRCTF_TRACE
     std::cout << "[+] RESPONSE\n";
+#endif
 }
 
 // Numeric
@@ -29,7 +57,32 @@ template<> void visitResponse<1>(
     server,
     gui::TabBar& tabBar
 ) {
+#ifdef IRCTF_TRACE
     std::cout << "[+] NUMERIC\n";
+#endif
+
+    irc::response::Numeric& numeric {
+        std::get<irc::response::Numeric>(varient)
+    };
+
+    if (numeric.numericID == irc::response::Numeric::RPL_WELCOME)
+    {
+        startup_trace::mark("registered");
+    }
+    else if (numeric.numericID == irc::response::Numeric::RPL_ISUPPORT)
+    {
+        // PREFIX=(modes)symbols, highest first
+        for (size_t i = 1; i + 1 < numeric.parsed.paramCount(); ++i)
+        {
+            std::string_view token = numeric.parsed.param(i);
+
+            if (token.starts_with("PREFIX=("))
+            {
+                server.getRoster().setPrefixes(token.substr(std::min(
+                    token.find(')') + 1, token.size())));
+            }
+        }
+    }
 }
 
 // Join
@@ -42,16 +95,40 @@ template<> void visitResponse<2>(
     using namespace irc::response;
     Join& join = std::get<Join>(varient);
 
-    std::cout << "[+] JOIN <" << join.channel << "> (" << join.nick << ")\n";
+#ifdef IRCTF_TRACE
+    std::cout << "[+] JOIN <" << join.channel() << "> (" << join.nick()
+        << ")\n";
+#endif
 
-    if (join.nick == irc::userNick)
+    server.getRoster().join(join.channelAtom, join.nickAtom,
+        server.isSelf(join.nickAtom));
+
+    if (server.isSelf(join.nickAtom))
     {
-        tabBar.addChannel(join.channel);
+        tabBar.addChannel(channelKey(server, join.channelAtom),
+            std::string(join.channel()));
+
+        auto messageDisplay {
+            tabBar.messageDisplays.find(channelKey(server, join.channelAtom))
+        };
+
+        // the list is filled in again by the NAMES reply that follows
+        if (messageDisplay != tabBar.messageDisplays.end())
+        {
+            messageDisplay->second.second.atoms = &server.getAtoms();
+            messageDisplay->second.second.memberList.reset(server.getAtoms());
+        }
+    }
+    else if (gui::MemberList* members = memberList(server, tabBar,
+        join.channelAtom))
+    {
+        members->add(join.nickAtom, 0,
+            static_cast<uint8_t>(server.getRoster().rank(0)));
     }
 
     // check if channel 
     auto messageDisplay {
-        tabBar.messageDisplays.find(join.channel)
+        tabBar.messageDisplays.find(channelKey(server, join.channelAtom))
     };
 
     if (messageDisplay == tabBar.messageDisplays.end())
@@ -59,7 +136,8 @@ template<> void visitResponse<2>(
         return;
     }
 
-    messageDisplay->second.second.logMessage(gui::log_item::Join { join.nick });
+    messageDisplay->second.second.logMessage(gui::log_item::Join {
+        join.nickAtom });
 }
 
 // Ping
@@ -70,7 +148,9 @@ template<> void visitResponse<3>(
 ) {
     using namespace irc::response;
 
+#ifdef IRCTF_TRACE
     std::cout << "[+] PING\n";
+#endif
     std::get<Ping>(varient).pong(server);
 }
 
@@ -84,24 +164,30 @@ void visitResponse<4>(
 ) {
     using namespace irc::response;
 
+#ifdef IRCTF_TRACE
     std::cout << "[+] PRIVMSG\n";
-    std::cout << "[" << std::get<Privmsg>(varient).channel << "] <" <<
-        std::get<Privmsg>(varient).nick << "> " <<
-        std::get<Privmsg>(varient).message << '\n';
+    std::cout << "[" << std::get<Privmsg>(varient).channel() << "] <" <<
+        std::get<Privmsg>(varient).nick() << "> " <<
+        std::get<Privmsg>(varient).message() << '\n';
+#endif
 
-    auto messageDisplay{tabBar.messageDisplays.find(std::get<Privmsg>
-        (varient).channel)};
+    auto messageDisplay{tabBar.messageDisplays.find(channelKey(server,
+        std::get<Privmsg>(varient).channelAtom))};
 
     if (messageDisplay == tabBar.messageDisplays.end())
     {
         return;
     }
 
+    // speakers come first when completing nicks
+    messageDisplay->second.second.memberList.spoke(
+        std::get<Privmsg>(varient).nickAtom);
+
     messageDisplay->second.second.logMessage(
         gui::log_item::Message {
             std::time(nullptr),
-            std::get<Privmsg>(varient).nick,
-            std::get<Privmsg>(varient).message
+            std::get<Privmsg>(varient).nickAtom,
+            std::get<Privmsg>(varient).message()
         }
     );
 }
@@ -114,15 +200,28 @@ template<> void visitResponse<5>(
 ) {
     irc::response::Part& part = std::get<irc::response::Part>(varient);
 
-    std::cout << "[+] PART " << part.channel << '\n';
+#ifdef IRCTF_TRACE
+    std::cout << "[+] PART " << part.channel() << '\n';
+#endif
+
+    server.getRoster().part(part.channelAtom, part.nickAtom,
+        server.isSelf(part.nickAtom));
 
-    if (part.nick == irc::userNick)
+    if (server.isSelf(part.nickAtom))
     {
-        tabBar.closeTab(std::get<irc::response::Part>(varient).channel);
+        tabBar.closeTab(channelKey(server, part.channelAtom));
     }
     else
     {
-        auto messageDisplay { tabBar.messageDisplays.find(part.channel) };
+        if (gui::MemberList* members = memberList(server, tabBar,
+            part.channelAtom))
+        {
+            members->remove(part.nickAtom);
+        }
+
+        auto messageDisplay {
+            tabBar.messageDisplays.find(channelKey(server, part.channelAtom))
+        };
 
         if (messageDisplay == tabBar.messageDisplays.end())
         {
@@ -130,11 +229,208 @@ template<> void visitResponse<5>(
         }
 
         messageDisplay->second.second.logMessage(
-            gui::log_item::Part { part.nick, part.message }
+            gui::log_item::Part { part.nickAtom, part.message() }
         );
     }
 }
 
+// Status
+template<> void visitResponse<6>(
+    irc::response::responseVarient& varient,
+    irc::Server& server,
+    gui::TabBar& tabBar
+) {
+    using namespace irc::response;
+    Status& status = std::get<Status>(varient);
+
+    static const char* const stateNames[] = {
+        "resolving",
+        "connecting to",
+        "connected to",
+        "connection failed:",
+        "disconnected:",
+        "reconnecting in"
+    };
+
+    std::cout << "[+] STATUS " << stateNames[status.state] << ' '
+        << status.detail << '\n';
+
+    if (status.state == Status::CONNECTED)
+    {
+        startup_trace::mark("connected");
+    }
+
+    auto messageDisplay {
+        tabBar.messageDisplays.find(gui::TabBar::globalKey)
+    };
+
+    if (messageDisplay == tabBar.messageDisplays.end())
+    {
+        return;
+    }
+
+    messageDisplay->second.second.logMessage(
+        gui::log_item::Message {
+            std::time(nullptr),
+            irc::NO_ATOM,
+            std::string(stateNames[status.state]) + ' ' + status.detail,
+            server.getHost()
+        }
+    );
+}
+
+// Quit
+template<> void visitResponse<7>(
+    irc::response::responseVarient& varient,
+    irc::Server& server,
+    gui::TabBar& tabBar
+) {
+    irc::response::Quit& quit = std::get<irc::response::Quit>(varient);
+
+#ifdef IRCTF_TRACE
+    std::cout << "[+] QUIT " << quit.nick() << '\n';
+#endif
+
+    // shown as leaving each channel the user shared with us
+    for (irc::Atom channel : server.getRoster().quit(quit.nickAtom))
+    {
+        auto messageDisplay {
+            tabBar.messageDisplays.find(channelKey(server, channel))
+        };
+
+        if (messageDisplay != tabBar.messageDisplays.end())
+        {
+            messageDisplay->second.second.memberList.remove(quit.nickAtom);
+            messageDisplay->second.second.logMessage(
+                gui::log_item::Part { quit.nickAtom, quit.message() }
+            );
+        }
+    }
+}
+
+// Nick
+template<> void visitResponse<8>(
+    irc::response::responseVarient& varient,
+    irc::Server& server,
+    gui::TabBar& tabBar
+) {
+    irc::response::Nick& nick = std::get<irc::response::Nick>(varient);
+
+#ifdef IRCTF_TRACE
+    std::cout << "[+] NICK " << nick.nick() << " -> " << nick.newNick()
+        << '\n';
+#endif
+
+    const std::string notice {
+        std::string(nick.nick()) + " is now known as "
+            + std::string(nick.newNick())
+    };
+
+    for (irc::Atom channel : server.getRoster().rename(nick.nickAtom,
+        nick.newNickAtom))
+    {
+        auto messageDisplay {
+            tabBar.messageDisplays.find(channelKey(server, channel))
+        };
+
+        if (messageDisplay != tabBar.messageDisplays.end())
+        {
+            messageDisplay->second.second.memberList.rename(nick.nickAtom,
+                nick.newNickAtom);
+            messageDisplay->second.second.logMessage(
+                gui::log_item::Message { std::time(nullptr), irc::NO_ATOM,
+                    notice, "*" }
+            );
+        }
+    }
+}
+
+// Kick
+template<> void visitResponse<9>(
+    irc::response::responseVarient& varient,
+    irc::Server& server,
+    gui::TabBar& tabBar
+) {
+    irc::response::Kick& kick = std::get<irc::response::Kick>(varient);
+    const bool self { server.isSelf(kick.targetAtom) };
+
+#ifdef IRCTF_TRACE
+    std::cout << "[+] KICK " << kick.channel() << ' ' << kick.target()
+        << '\n';
+#endif
+
+    server.getRoster().part(kick.channelAtom, kick.targetAtom, self);
+
+    if (self)
+    {
+        tabBar.closeTab(channelKey(server, kick.channelAtom));
+        return;
+    }
+
+    auto messageDisplay {
+        tabBar.messageDisplays.find(channelKey(server, kick.channelAtom))
+    };
+
+    if (messageDisplay == tabBar.messageDisplays.end())
+    {
+        return;
+    }
+
+    messageDisplay->second.second.memberList.remove(kick.targetAtom);
+
+    const std::string reason {
+        "kicked by " + std::string(kick.nick())
+            + (kick.message() ? ": " + std::string(*kick.message()) : "")
+    };
+
+    messageDisplay->second.second.logMessage(
+        gui::log_item::Part { kick.targetAtom, reason }
+    );
+}
+
+// Names
+template<> void visitResponse<10>(
+    irc::response::responseVarient& varient,
+    irc::Server& server,
+    gui::TabBar& tabBar
+) {
+    irc::response::Names& names = std::get<irc::response::Names>(varient);
+
+    if (names.complete())
+    {
+        irc::Roster& roster = server.getRoster();
+        roster.endOfNames(names.channelAtom);
+
+        gui::MemberList* members = memberList(server, tabBar,
+            names.channelAtom);
+
+        if (!members)
+        {
+            return;
+        }
+
+        // the whole listing is sorted into the list at once
+        std::vector<gui::MemberList::Row> rows;
+        rows.reserve(roster.members(names.channelAtom).size());
+
+        for (const irc::Roster::Member& member
+            : roster.members(names.channelAtom))
+        {
+            rows.push_back(gui::MemberList::Row {
+                member.nick,
+                member.prefix,
+                static_cast<uint8_t>(roster.rank(member.prefix))
+            });
+        }
+
+        members->assign(std::move(rows));
+    }
+    else
+    {
+        server.getRoster().names(names.channelAtom, names.members);
+    }
+}
+
 template void visitResponse<0>(irc::response::responseVarient& varient,
     irc::Server& server, gui::TabBar& tabBar);
 template void visitResponse<1>(irc::response::responseVarient& varient,
@@ -147,3 +443,13 @@ template void visitResponse<4>(irc::response::responseVarient& varient,
     irc::Server& server, gui::TabBar& tabBar);
 template void visitResponse<5>(irc::response::responseVarient& varient,
     irc::Server& server, gui::TabBar& tabBar);
+template void visitResponse<6>(irc::response::responseVarient& varient,
+    irc::Server& server, gui::TabBar& tabBar);
+template void visitResponse<7>(irc::response::responseVarient& varient,
+    irc::Server& server, gui::TabBar& tabBar);
+template void visitResponse<8>(irc::response::responseVarient& varient,
+    irc::Server& server, gui::TabBar& tabBar);
+template void visitResponse<9>(irc::response::responseVarient& varient,
+    irc::Server& server, gui::TabBar& tabBar);
+template void visitResponse<10>(irc::response::responseVarient& varient,
+    irc::Server& server, gui::TabBar& tabBar);
\ No newline at end of file